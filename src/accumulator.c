@@ -0,0 +1,177 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include <string.h>
+#include "accumulator.h"
+#include "workspace.h"
+
+/* rows reduced at once by a thread: a few pages */
+#define ACCUMULATOR_BLOCK 4096
+/* initial capacity of the hash table of each thread */
+#define SPARSE_MIN_CAPACITY 1024
+
+thread_accumulator* new_thread_accumulator(int nb_threads, long length){
+  int per_line = WORKSPACE_ALIGN / sizeof(int64_t);
+  thread_accumulator *acc = malloc(sizeof(thread_accumulator));
+  acc->nb_threads = (nb_threads > 0 ? nb_threads : 1);
+  acc->length = length;
+  acc->stride = ((length + per_line - 1) / per_line) * per_line;
+  if(acc->stride == 0) acc->stride = per_line;
+  acc->rows = aligned_malloc(((size_t)acc->nb_threads) * acc->stride * sizeof(int64_t), 0);
+  memset(acc->rows, 0, ((size_t)acc->nb_threads) * acc->stride * sizeof(int64_t));
+  return acc;
+}
+
+void free_thread_accumulator(thread_accumulator *acc){
+  aligned_free(acc->rows);
+  free(acc);
+}
+
+int64_t* thread_accumulator_row(thread_accumulator *acc, int thread){
+  return acc->rows + ((size_t)thread) * acc->stride;
+}
+
+void thread_accumulator_fill(thread_accumulator *acc, int64_t value){
+  size_t i;
+  for(i=0; i<((size_t)acc->nb_threads) * acc->stride; i++) acc->rows[i] = value;
+}
+
+/* rows summed (or their min taken) over the threads into row 0 */
+static int64_t* thread_accumulator_merge(thread_accumulator *acc, int min){
+  long first;
+  /* the rows are cut in blocks, each one merged over the threads by one thread:
+     row t += row t+step, for step = 1, 2, 4... */
+#pragma omp parallel for shared(acc, min) schedule(static)
+  for(first=0; first<acc->length; first+=ACCUMULATOR_BLOCK){
+    long last = (first + ACCUMULATOR_BLOCK < acc->length ? first + ACCUMULATOR_BLOCK : acc->length), i;
+    int t, step;
+    for(step=1; step<acc->nb_threads; step<<=1){
+      for(t=0; t+step<acc->nb_threads; t+=2*step){
+	int64_t *a = thread_accumulator_row(acc, t), *b = thread_accumulator_row(acc, t+step);
+	if(min){
+	  for(i=first; i<last; i++) if(b[i] < a[i]) a[i] = b[i];
+	} else {
+	  for(i=first; i<last; i++) a[i] += b[i];
+	}
+      }
+    }
+  }
+  return acc->rows;
+}
+
+int64_t* thread_accumulator_reduce(thread_accumulator *acc){
+  return thread_accumulator_merge(acc, 0);
+}
+
+int64_t* thread_accumulator_reduce_min(thread_accumulator *acc){
+  return thread_accumulator_merge(acc, 1);
+}
+
+int64_t accumulator_fixed(int64_t num, int64_t den){
+  return ((num << ACCUMULATOR_FRAC_BITS) + den / 2) / den;
+}
+
+static void sparse_table_init(sparse_table *t, long capacity){
+  long i;
+  t->capacity = capacity;
+  t->nb_used = 0;
+  t->entries = malloc(capacity * sizeof(sparse_entry));
+  for(i=0; i<capacity; i++) t->entries[i].key = -1;
+}
+
+static inline long sparse_slot(int64_t key, long mask){
+  uint64_t h = ((uint64_t)key) * 0x9e3779b97f4a7c15ULL;
+  return (long)((h ^ (h >> 29)) & mask);
+}
+
+sparse_accumulator* new_sparse_accumulator(int nb_threads){
+  int t;
+  sparse_accumulator *acc = malloc(sizeof(sparse_accumulator));
+  acc->nb_threads = (nb_threads > 0 ? nb_threads : 1);
+  acc->tables = aligned_malloc(acc->nb_threads * sizeof(sparse_table), 0);
+  for(t=0; t<acc->nb_threads; t++) sparse_table_init(acc->tables + t, SPARSE_MIN_CAPACITY);
+  return acc;
+}
+
+void free_sparse_accumulator(sparse_accumulator *acc){
+  int t;
+  for(t=0; t<acc->nb_threads; t++) free(acc->tables[t].entries);
+  aligned_free(acc->tables);
+  free(acc);
+}
+
+void sparse_accumulator_add(sparse_accumulator *acc, int thread, int64_t key, int64_t value){
+  sparse_table *t = acc->tables + thread;
+  long i, j, old_capacity;
+  sparse_entry *old;
+  for(i = sparse_slot(key, t->capacity-1); t->entries[i].key != -1; i = (i+1) & (t->capacity-1)){
+    if(t->entries[i].key == key){
+      t->entries[i].value += value;
+      return;
+    }
+  }
+  t->entries[i].key = key;
+  t->entries[i].value = value;
+  /* at most half full */
+  if(++t->nb_used * 2 > t->capacity){
+    old = t->entries;
+    old_capacity = t->capacity;
+    sparse_table_init(t, 2*old_capacity);
+    for(j=0; j<old_capacity; j++){
+      if(old[j].key == -1) continue;
+      for(i = sparse_slot(old[j].key, t->capacity-1); t->entries[i].key != -1; i = (i+1) & (t->capacity-1));
+      t->entries[i] = old[j];
+      t->nb_used++;
+    }
+    free(old);
+  }
+}
+
+static int compare_sparse_entries(const void *a, const void *b){
+  int64_t ka = ((const sparse_entry*)a)->key, kb = ((const sparse_entry*)b)->key;
+  return (ka > kb) - (ka < kb);
+}
+
+long sparse_accumulator_reduce(sparse_accumulator *acc, sparse_entry **entries){
+  long nb = 0, nb_merged = 0, i;
+  int t;
+  sparse_entry *all;
+  for(t=0; t<acc->nb_threads; t++) nb += acc->tables[t].nb_used;
+  all = malloc((nb > 0 ? nb : 1) * sizeof(sparse_entry));
+  nb = 0;
+  for(t=0; t<acc->nb_threads; t++){
+    for(i=0; i<acc->tables[t].capacity; i++){
+      if(acc->tables[t].entries[i].key != -1) all[nb++] = acc->tables[t].entries[i];
+    }
+  }
+  /* the counters of the same key are then consecutive */
+  qsort(all, nb, sizeof(sparse_entry), compare_sparse_entries);
+  for(i=0; i<nb; i++){
+    if(nb_merged > 0 && all[nb_merged-1].key == all[i].key) all[nb_merged-1].value += all[i].value;
+    else all[nb_merged++] = all[i];
+  }
+  *entries = all;
+  return nb_merged;
+}
@@ -0,0 +1,89 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _ACCUMULATOR_H_
+#define _ACCUMULATOR_H_
+
+#include <stdint.h>
+
+/*
+  Counters summed over the bootstrap trees by all the threads, without atomics: each thread adds to its
+  own row, padded to whole cache lines so that two threads never write to the same line, and the rows 
+  are summed at the end in a fixed order (a binary tree over the threads). The counters are integers, so
+  the sums do not depend on the number of threads nor on the trees each thread got.
+*/
+typedef struct thread_accumulator{
+  int nb_threads;
+  long length;     /* counters per thread */
+  long stride;     /* padded length of a row */
+  int64_t *rows;   /* row of thread t at rows + t * stride, initialized to 0 */
+} thread_accumulator;
+
+/* fractional counters are stored in fixed point, with ACCUMULATOR_FRAC_BITS fractional bits */
+#define ACCUMULATOR_FRAC_BITS 32
+#define ACCUMULATOR_ONE (((int64_t)1) << ACCUMULATOR_FRAC_BITS)
+
+thread_accumulator* new_thread_accumulator(int nb_threads, long length);
+void free_thread_accumulator(thread_accumulator *acc);
+// Row of the given thread (omp_get_thread_num())
+int64_t* thread_accumulator_row(thread_accumulator *acc, int thread);
+// Sets all the counters of all the threads (to INT64_MAX before thread_accumulator_reduce_min)
+void thread_accumulator_fill(thread_accumulator *acc, int64_t value);
+// Sums the rows of all the threads into row 0, and returns it
+int64_t* thread_accumulator_reduce(thread_accumulator *acc);
+// Same with the min instead of the sum (a max is the min of the opposite values)
+int64_t* thread_accumulator_reduce_min(thread_accumulator *acc);
+// Fixed point value of num / den (0 <= num < 2^31, den > 0), rounded to the nearest
+int64_t accumulator_fixed(int64_t num, int64_t den);
+
+/*
+  Same for counters that are almost all 0 (e.g. one per branch and taxon): each thread adds to its own
+  hash table (open addressing, keys >= 0), and the tables are merged at the end into a list sorted by key.
+*/
+typedef struct sparse_entry{
+  int64_t key;
+  int64_t value;
+} sparse_entry;
+
+typedef struct sparse_table{
+  long capacity;   /* power of 2 */
+  long nb_used;
+  sparse_entry *entries; /* key -1: empty */
+  char pad[64 - sizeof(long) * 2 - sizeof(sparse_entry*)]; /* one cache line per thread */
+} sparse_table;
+
+typedef struct sparse_accumulator{
+  int nb_threads;
+  sparse_table *tables;
+} sparse_accumulator;
+
+sparse_accumulator* new_sparse_accumulator(int nb_threads);
+void free_sparse_accumulator(sparse_accumulator *acc);
+// Adds value to the counter key (>= 0) of the given thread
+void sparse_accumulator_add(sparse_accumulator *acc, int thread, int64_t key, int64_t value);
+// Sums of all the threads, the non zero counters sorted by key: returns their number, and the list in *entries (to free)
+long sparse_accumulator_reduce(sparse_accumulator *acc, sparse_entry **entries);
+
+#endif
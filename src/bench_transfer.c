@@ -0,0 +1,149 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+/*
+  Throughput of the tbe kernels on random trees, on one core:
+  ./bench_transfer [nb_taxa [nb_bootstrap_trees]]
+  For each kernel, gives the time per bootstrap tree and the number of cells of the 
+  (internal ref edges x bootstrap edges) matrix processed per second. "rows" is the row 
+  per ref edge I matrix of update_all_i_post_order_*_tree, "dense" and "columns" are the 
+  kernels of transfer.c with each supported SIMD level, "batch" the batch kernel (--batch) on batches
+  of BENCH_BATCH trees, "popcount", "fast" and "sparse" the kernels of -a tbe-popcount, tbe-fast and tbe-sparse.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include "tree.h"
+#include "tree_utils.h"
+#include "transfer.h"
+
+/* the row kernel is not run above this number of taxa: too slow */
+#define BENCH_ROWS_MAX_TAXA 5000
+
+/* number of bootstrap trees per batch of the batch kernel */
+#define BENCH_BATCH 8
+
+static void print_result(char *kernel, char *level, double seconds, int nb_trees, double cells){
+  fprintf(stdout,"%-8s\t%-7s\t%10.3f\t%10.1f\n", kernel, level, seconds * 1000.0 / nb_trees, cells * nb_trees / seconds / 1e6);
+}
+
+int main(int argc, char** argv){
+  int n = (argc > 1 ? atoi(argv[1]) : 2000);
+  int nb_trees = (argc > 2 ? atoi(argv[2]) : 20);
+  int i, t, b, nb, level, kernel;
+  Tree *seed_tree, *ref_tree, **boot_trees;
+  ref_index *ref;
+  tbe_workspace *ws, *batch_ws[BENCH_BATCH];
+  double start, cells;
+
+  if(n < 4 || n > TBE_MAX_TAXA || nb_trees < 1){
+    fprintf(stderr,"Usage: %s [nb_taxa (4..%d) [nb_bootstrap_trees]]\n", argv[0], TBE_MAX_TAXA);
+    return EXIT_FAILURE;
+  }
+  srand(1);
+  seed_tree = gen_rand_tree(n, NULL);
+  ref_tree = gen_random_tree(seed_tree);
+  boot_trees = malloc(nb_trees * sizeof(Tree*));
+  for(t=0; t<nb_trees; t++) boot_trees[t] = gen_random_tree(seed_tree);
+  ref = new_ref_index(ref_tree);
+  cells = ((double)ref->nb_internal) * (2*n-3);
+
+  fprintf(stdout,"%d taxa, %d bootstrap trees\n", n, nb_trees);
+  fprintf(stdout,"Kernel  \tSIMD   \tms/tree   \tMcells/s\n");
+
+  if(n <= BENCH_ROWS_MAX_TAXA){
+    short unsigned **i_matrix = malloc(ref_tree->nb_edges * sizeof(short unsigned*));
+    short unsigned *min_dist = malloc(ref_tree->nb_edges * sizeof(short unsigned));
+    short unsigned *min_dist_edge = malloc(ref_tree->nb_edges * sizeof(short unsigned));
+    int *boot_leaf_edge = malloc(n * sizeof(int));
+    for(i=0; i<ref_tree->nb_edges; i++) i_matrix[i] = malloc((2*n-2) * sizeof(short unsigned));
+    start = omp_get_wtime();
+    for(t=0; t<nb_trees; t++){
+      for(i=0; i<ref_tree->nb_edges; i++) min_dist[i] = n;
+      update_all_i_post_order_ref_tree(ref_tree, boot_trees[t], i_matrix, min_dist, min_dist_edge, boot_leaf_edge);
+      update_all_i_post_order_boot_tree(ref_tree, boot_trees[t], i_matrix, min_dist, min_dist_edge);
+    }
+    print_result("rows", "-", omp_get_wtime() - start, nb_trees, cells);
+    for(i=0; i<ref_tree->nb_edges; i++) free(i_matrix[i]);
+    free(i_matrix);
+    free(min_dist);
+    free(min_dist_edge);
+    free(boot_leaf_edge);
+  }
+
+  for(kernel=TBE_KERNEL_DENSE; kernel<=TBE_KERNEL_COLUMNS; kernel++){
+    ws = new_tbe_workspace(n, ref_tree->nb_edges, ref->nb_internal, kernel, 0);
+    for(level=TBE_SIMD_SCALAR; level<=TBE_SIMD_AVX512; level++){
+      if(tbe_simd_select(level) == -1) continue;
+      start = omp_get_wtime();
+      for(t=0; t<nb_trees; t++) min_transfer_distances(ref, boot_trees[t], ws);
+      print_result(kernel == TBE_KERNEL_DENSE ? "dense" : "columns", (char*)tbe_simd_name(level), omp_get_wtime() - start, nb_trees, cells);
+    }
+    free_tbe_workspace(ws);
+  }
+
+  for(b=0; b<BENCH_BATCH; b++) batch_ws[b] = new_tbe_workspace(n, ref_tree->nb_edges, ref->nb_internal, TBE_KERNEL_BATCH, 0);
+  for(level=TBE_SIMD_SCALAR; level<=TBE_SIMD_AVX512; level++){
+    if(tbe_simd_select(level) == -1) continue;
+    start = omp_get_wtime();
+    for(t=0; t<nb_trees; t+=BENCH_BATCH){
+      nb = (t + BENCH_BATCH < nb_trees ? BENCH_BATCH : nb_trees - t);
+      for(b=0; b<nb; b++) tbe_batch_compile(boot_trees[t+b], batch_ws[b]);
+      min_transfer_distances_batch(ref, batch_ws, nb);
+    }
+    print_result("batch", (char*)tbe_simd_name(level), omp_get_wtime() - start, nb_trees, cells);
+  }
+  for(b=0; b<BENCH_BATCH; b++) free_tbe_workspace(batch_ws[b]);
+
+  ref_index_add_clades(ref);
+  ws = new_tbe_workspace(n, ref_tree->nb_edges, ref->nb_internal, TBE_KERNEL_POPCOUNT, 0);
+  start = omp_get_wtime();
+  for(t=0; t<nb_trees; t++) min_transfer_distances(ref, boot_trees[t], ws);
+  print_result("popcount", "-", omp_get_wtime() - start, nb_trees, cells);
+  free_tbe_workspace(ws);
+
+  ref_index_add_steps(ref);
+  ws = new_tbe_workspace(n, ref_tree->nb_edges, ref->nb_internal, TBE_KERNEL_FAST, 0);
+  start = omp_get_wtime();
+  for(t=0; t<nb_trees; t++) min_transfer_distances(ref, boot_trees[t], ws);
+  print_result("fast", "-", omp_get_wtime() - start, nb_trees, cells);
+  free_tbe_workspace(ws);
+
+  ref_index_add_sparse(ref, n / TBE_SPARSE_DEPTH_RATIO);
+  ws = new_tbe_workspace(n, ref_tree->nb_edges, ref->nb_internal, TBE_KERNEL_SPARSE, 0);
+  start = omp_get_wtime();
+  for(t=0; t<nb_trees; t++) min_transfer_distances(ref, boot_trees[t], ws);
+  print_result("sparse", "-", omp_get_wtime() - start, nb_trees, cells);
+  free_tbe_workspace(ws);
+
+  free_ref_index(ref);
+  for(t=0; t<nb_trees; t++) free_tree(boot_trees[t]);
+  free(boot_trees);
+  free_tree(ref_tree);
+  free_tree(seed_tree);
+  return EXIT_SUCCESS;
+}
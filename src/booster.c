@@ -25,7 +25,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "io.h"
 #include "tree.h"
-#include "bitset_index.h"
+#include "split_table.h"
+#include "consensus.h"
+#include "transfer.h"
+#include "supports.h"
 
 #include <string.h> /* for strcpy, strdup, etc */
 #include <getopt.h>
@@ -39,23 +42,63 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
    (tree structures, tbe algorithm)
 */
 
-void tbe(Tree *ref_tree, Tree *ref_raw_tree, char **alt_tree_strings,char** taxname_lookup_table, FILE *stat_file, int num_trees, int quiet, double dist_cutoff,int count_per_branch);
-void fbp(Tree *ref_tree, char **alt_tree_strings,char** taxname_lookup_table, int num_trees, int quiet);
-int* species_to_move(Edge* re, Edge* be, int dist, int nb_taxa);
+/* long options without short equivalent */
+#define OPT_CONSENSUS      1000
+#define OPT_CONSENSUS_TYPE 1001
+#define OPT_LOW_MEM        1002
+#define OPT_HUGE_PAGES     1003
+#define OPT_SIMD           1004
+#define OPT_BATCH          1005
+#define OPT_CONTRACT       1006
+#define OPT_CACHE_MEM      1007
+#define OPT_DEDUP          1008
+#define OPT_HIST           1009
+#define OPT_HIST_FORMAT    1010
+#define OPT_COUNT_FILE     1011
+#define OPT_COUNT_FORMAT   1012
+#define OPT_OUT_FBP        1013
+
 
 void usage(FILE * out,char *name){
   fprintf(out,"Usage: ");
   fprintf(out,"%s -i <ref tree file (newick)> -b <bootstrap tree file (newick)> [-@ <cpus> -d <dist_cutoff> -r <raw distance output tree file> -S <stat file> -o <output tree> -v]\n",name);
   fprintf(out,"Options:\n");
-  fprintf(out,"      -i, --input            : Input tree file\n");
+  fprintf(out,"      -i, --input            : Input tree file (several reference trees: one output tree per reference)\n");
   fprintf(out,"      -b, --boot             : Bootstrap tree file (1 file containing all bootstrap trees)\n");
   fprintf(out,"      -o, --out              : Output file (optional) with normalized support values, default : stdout\n");
   fprintf(out,"      -r, --out-raw          : Output file (optional) with raw support values in the form of id|avgdist|depth, default : none\n");
-  fprintf(out,"      -@, --num-threads      : Number of threads (default 1)\n");
+  fprintf(out,"      --out-fbp              : Output file (optional) with the fbp supports of -a tbe,fbp, default : after the tbe tree\n");
+  fprintf(out,"      -@, --num-threads      : Number of threads (default 1). With fewer bootstrap trees than threads, tbe\n");
+  fprintf(out,"                               shares the branches of each tree among the threads\n");
   fprintf(out,"      -S, --stat-file        : Prints output statistics for each branch in the given output file (optional)\n");
   fprintf(out,"      -c, --count-per-branch : Prints individual taxa moves for each branches in the log file (only with -S & -a tbe)\n");
   fprintf(out,"      -d, --dist-cutoff      : Distance cutoff to consider a branch for taxa transfer index computation (-a tbe only, default 0.3)\n");
-  fprintf(out,"      -a, --algo             : tbe or fbp (default tbe)\n");
+  fprintf(out,"      -a, --algo             : tbe, tbe-popcount, tbe-fast, tbe-sparse, fbp or fbp-table (default tbe)\n");
+  fprintf(out,"                               tbe,fbp (or tbe-fast,fbp...): both supports, each bootstrap tree being parsed once\n");
+  fprintf(out,"                               tbe-fast: tbe in O(n log^3 n) per bootstrap tree, for very large trees\n");
+  fprintf(out,"                               tbe-sparse: tbe computed only around the leaves of the shallow branches\n");
+  fprintf(out,"                               fbp-table: fbp computed with a single split table shared by all threads\n");
+  fprintf(out,"      --low-mem              : Computes the transfer distances column by column, with memory proportional to the height\n");
+  fprintf(out,"                               of the bootstrap trees (-a tbe only, automatic if the full matrix is larger than 1GB)\n");
+  fprintf(out,"      --huge-pages           : Backs the large tbe work arrays with transparent huge pages (-a tbe only, Linux)\n");
+  fprintf(out,"      --simd                 : Vector instructions of the tbe kernel: auto (default), scalar, avx2 or avx512\n");
+  fprintf(out,"      --batch                : Number of bootstrap trees processed together by each thread, on tiles of the\n");
+  fprintf(out,"                               reference tree kept in cache (-a tbe only, default 1: one tree at a time)\n");
+  fprintf(out,"      --cache-mem            : Memory (MB) of a cache of the bootstrap subtrees common to several bootstrap trees,\n");
+  fprintf(out,"                               shared by all threads (-a tbe only, default 0: no cache)\n");
+  fprintf(out,"      --contract             : Removes the subtrees common to the reference and each bootstrap tree before\n");
+  fprintf(out,"                               computing the transfer distances (-a tbe only, faster on well supported trees)\n");
+  fprintf(out,"      --dedup                : Bootstrap trees with the same unrooted topology are analyzed once, and counted\n");
+  fprintf(out,"                               as many times as they appear (ignored, with a warning, with --consensus\n");
+  fprintf(out,"                               or -a fbp-table)\n");
+  fprintf(out,"      --hist                 : Output file (optional) with the histogram of the normalized transfer distance\n");
+  fprintf(out,"                               of each branch over the bootstrap trees (-a tbe only)\n");
+  fprintf(out,"      --hist-format          : tsv or bin, default : tsv\n");
+  fprintf(out,"      --count-file           : Output file (optional) with the non zero taxa moves of -c, as (branch, taxon, value)\n");
+  fprintf(out,"                               triples, instead of the table of the stat file (-a tbe only)\n");
+  fprintf(out,"      --count-format         : tsv or bin, default : tsv\n");
+  fprintf(out,"      --consensus            : Output file (optional) with the consensus tree of the bootstrap trees\n");
+  fprintf(out,"      --consensus-type       : majority or extended (greedy extended majority rule), default : majority\n");
   fprintf(out,"      -q, --quiet            : Does not print progress messages during analysis\n");
   fprintf(out,"      -v, --version          : Prints version (optional)\n");
   fprintf(out,"      -h, --help             : Prints this help\n");
@@ -66,7 +109,7 @@ void usage(FILE * out,char *name){
   fprintf(out,"Nature 556, 452-456 (2018)\n");
 }
 
-void printOptions(FILE * out,char* input_tree,char * boot_trees, char * output_tree, char * output_raw_tree, char *output_stat, char *algo, int nb_threads, int quiet, double dist_cutoff, int count_per_branch){
+void printOptions(FILE * out,char* input_tree,char * boot_trees, char * output_tree, char * output_raw_tree, char *output_stat, char *algo, int nb_threads, int quiet, double dist_cutoff, int count_per_branch, char *consensus_out, char *consensus_type, char *simd){
   fprintf(out,"**************************\n");
   fprintf(out,"*         Options        *\n");
   fprintf(out,"**************************\n");
@@ -84,6 +127,10 @@ void printOptions(FILE * out,char* input_tree,char * boot_trees, char * output_t
   else
     fprintf(out,"Stat file       : %s\n",output_stat);
   fprintf(out,"Algo            : %s\n", algo);
+  if(!strcmp(algo,"tbe"))
+    fprintf(out,"SIMD kernel     : %s\n", simd);
+  if(consensus_out!=NULL)
+    fprintf(out,"Consensus tree  : %s (%s)\n", consensus_out, consensus_type);
   if(count_per_branch){
     fprintf(out,"Count tax move/branch: true\n");
   }else{
@@ -98,35 +145,6 @@ void printOptions(FILE * out,char* input_tree,char * boot_trees, char * output_t
   fprintf(out,"**************************\n");
 }
 
-void reset_matrices(int nb_taxa, int nb_edges_ref, int nb_edges_boot, short unsigned*** c_matrix, short unsigned*** i_matrix, short unsigned*** hamming, short unsigned** min_dist, short unsigned** min_dist_edges){
-  int i;
-  (*min_dist) = (short unsigned*) malloc(nb_edges_ref*sizeof(short unsigned)); /* array of min Hamming distances */
-  (*min_dist_edges) = (short unsigned*) malloc(nb_edges_ref*sizeof(short unsigned)); /* array of edge ids corresponding to min Hamming distances */
-  (*c_matrix) = (short unsigned**) malloc(nb_edges_ref*sizeof(short unsigned*)); /* matrix of cardinals of complements */
-  (*i_matrix) = (short unsigned**) malloc(nb_edges_ref*sizeof(short unsigned*)); /* matrix of cardinals of intersections */
-  (*hamming) = (short unsigned**) malloc(nb_edges_ref*sizeof(short unsigned*)); /* matrix of Hamming distances */
-  for (i=0; i<nb_edges_ref; i++){
-    (*c_matrix)[i] = (short unsigned*) malloc(nb_edges_boot*sizeof(short unsigned));
-    (*i_matrix)[i] = (short unsigned*) malloc(nb_edges_boot*sizeof(short unsigned));
-    (*hamming)[i] = (short unsigned*) malloc(nb_edges_boot*sizeof(short unsigned));
-    (*min_dist)[i] = nb_taxa; /* initialization to the nb of taxa */
-  }
-}
-
-void free_matrices(int nb_edges_ref, short unsigned*** c_matrix, short unsigned*** i_matrix, short unsigned*** hamming, short unsigned** min_dist, short unsigned** min_dist_edges){
-  int i;
-  for (i=0; i<nb_edges_ref; i++) {
-    free((*c_matrix)[i]);
-    free((*i_matrix)[i]);
-    free((*hamming)[i]);
-  }
-  free((*c_matrix));
-  free((*i_matrix));
-  free((*hamming));
-  free((*min_dist));
-  free((*min_dist_edges));
-}
-
 int main (int argc, char* argv[]) {
   /* this program takes as input three arguments.
      Arg1 is the filename of the reference tree.
@@ -134,7 +152,7 @@ int main (int argc, char* argv[]) {
      OR Arg2 is a single file containing all the bootstrap trees, one per line.
      Arg3 is the name of the output file (output tree with bootstrap values). */
 
-  int i, retcode;
+  int i;
   /* int one_side; /\* to store a number of taxa seen on one side of a branch in the ref tree *\/ */
 
   FILE *output_file = NULL;
@@ -142,18 +160,30 @@ int main (int argc, char* argv[]) {
   FILE *boottree_file = NULL;
   FILE *stat_file = NULL;
   FILE *output_raw_file = NULL; /* Output tree file with edge bootstrap values noted as "id|avgdist|topo_depth" */
+  FILE *output_fbp_file = NULL; /* Output tree file with the fbp supports, with -a tbe,fbp */
+  FILE *consensus_file = NULL;
   
   char *input_tree = NULL;
   char *boot_trees = NULL;
   char *out_tree = NULL;
   char *out_raw_tree = NULL;
+  char *out_fbp_tree = NULL;
   char *stat_out = NULL;
-
-  Tree *ref_tree;
-  Tree *ref_raw_tree = NULL; /* For raw support at edges : id|avgdist|depth */
+  char *consensus_out = NULL;
+  char *consensus_type = "majority";
+
+  Tree **ref_trees; /* all the trees of the input file, each one scored against the same bootstrap trees */
+  int nb_refs = 0, max_refs = 1, i_ref;
+  double **mean_dist = NULL; /* For raw support at edges : id|avgdist|depth */
+  int **nb_found = NULL; /* For fbp supports computed with tbe */
+  Tree *consensus = NULL;
+  split_table *st = NULL; /* counts of the bootstrap splits, for fbp-table and consensus */
   char **alt_tree_strings;
 
   char *algo = "tbe";
+  /* -a tbe,fbp: both supports in a single pass over the bootstrap trees */
+  int with_fbp = 0;
+  char *fbp_suffix;
   
   int quiet = 0;
   
@@ -163,12 +193,48 @@ int main (int argc, char* argv[]) {
 
   /* If true, compute and print in the log file the (normalized) number of moves of each taxa for all branches */
   int count_per_branch = 0;
+
+  /* If true, the tbe kernel does not store the whole I matrix, but only O(log(n)) columns */
+  int low_mem = 0;
+
+  /* If true, the tbe work arrays are madvised for transparent huge pages */
+  int huge_pages = 0;
+
+  /* Vector instructions of the tbe kernel */
+  char *simd = "auto";
+  int simd_level = TBE_SIMD_AUTO;
+
+  /* Number of bootstrap trees given to the batch tbe kernel at once (1: no batch) */
+  int batch = 1;
+
+  /* Memory (MB) of the cache of the columns of the bootstrap subtrees (0: no cache) */
+  int cache_mem = 0;
+
+  /* If true, each distinct topology of the bootstrap trees is analyzed once */
+  int dedup = 0;
+
+  /* If true, the subtrees common to the ref tree and each bootstrap tree are contracted before the tbe kernel */
+  int contract = 0;
+
+  /* Histograms of the transfer distances of each branch (--hist), as text (tsv) or binary (bin) */
+  char *hist_out = NULL;
+  char *hist_format = "tsv";
+  FILE *hist_file = NULL;
+
+  /* The -c counts as (branch, taxon, value) triples in their own file (--count-file), as text (tsv) or binary (bin) */
+  char *count_out = NULL;
+  char *count_format = "tsv";
+  FILE *count_file = NULL;
+
+  /* kernel of the tbe algorithm */
+  int kernel;
 	
   static struct option long_options[] = {
     {"input", required_argument, 0, 'i'},
     {"boot" , required_argument, 0, 'b'},
     {"out"  , required_argument, 0, 'o'},
     {"out-raw"  , required_argument, 0, 'r'},
+    {"out-fbp"  , required_argument, 0, OPT_OUT_FBP},
     {"count-per-branch", no_argument, 0, 'c'},
     {"stat-file" , required_argument, 0, 'S'},
     {"algo" , required_argument, 0, 'a'},
@@ -177,6 +243,19 @@ int main (int argc, char* argv[]) {
     {"help" , no_argument      , 0, 'h'},
     {"version", no_argument      , 0, 'v'},
     {"quiet", no_argument      , 0, 'q'},
+    {"consensus", required_argument, 0, OPT_CONSENSUS},
+    {"low-mem", no_argument, 0, OPT_LOW_MEM},
+    {"huge-pages", no_argument, 0, OPT_HUGE_PAGES},
+    {"simd", required_argument, 0, OPT_SIMD},
+    {"batch", required_argument, 0, OPT_BATCH},
+    {"contract", no_argument, 0, OPT_CONTRACT},
+    {"cache-mem", required_argument, 0, OPT_CACHE_MEM},
+    {"dedup", no_argument, 0, OPT_DEDUP},
+    {"hist", required_argument, 0, OPT_HIST},
+    {"hist-format", required_argument, 0, OPT_HIST_FORMAT},
+    {"count-file", required_argument, 0, OPT_COUNT_FILE},
+    {"count-format", required_argument, 0, OPT_COUNT_FORMAT},
+    {"consensus-type", required_argument, 0, OPT_CONSENSUS_TYPE},
     {0, 0, 0, 0}
   };
 
@@ -195,6 +274,20 @@ int main (int argc, char* argv[]) {
     case 'S': stat_out = optarg; break;
     case 'r': out_raw_tree = optarg; break;
     case 'q': quiet = 1; break;
+    case OPT_CONSENSUS: consensus_out = optarg; break;
+    case OPT_LOW_MEM: low_mem = 1; break;
+    case OPT_HUGE_PAGES: huge_pages = 1; break;
+    case OPT_SIMD: simd = optarg; break;
+    case OPT_BATCH: batch = strtol(optarg,NULL,10); break;
+    case OPT_CONTRACT: contract = 1; break;
+    case OPT_CACHE_MEM: cache_mem = strtol(optarg,NULL,10); break;
+    case OPT_DEDUP: dedup = 1; break;
+    case OPT_HIST: hist_out = optarg; break;
+    case OPT_HIST_FORMAT: hist_format = optarg; break;
+    case OPT_COUNT_FILE: count_out = optarg; break;
+    case OPT_COUNT_FORMAT: count_format = optarg; break;
+    case OPT_CONSENSUS_TYPE: consensus_type = optarg; break;
+    case OPT_OUT_FBP: out_fbp_tree = optarg; break;
     case 'h': usage(stdout,argv[0]); return EXIT_SUCCESS; break; 
     case 'v': version(stdout,argv[0]); return EXIT_SUCCESS; break;
     case ':': fprintf(stderr, "Option -%c requires an argument\n", optopt); return EXIT_FAILURE; break;
@@ -202,11 +295,53 @@ int main (int argc, char* argv[]) {
     }
   }
 
-  if(strcmp(algo,"tbe") && strcmp(algo,"fbp")){
-    fprintf(stderr,"Algo option must be one of \"tbe\" or \"fbp\"\n");
+  if(!strncmp(algo,"tbe",3) && (fbp_suffix = strstr(algo,",fbp")) != NULL && fbp_suffix[4] == '\0'){
+    with_fbp = 1;
+    *fbp_suffix = '\0';
+  }
+  if(strcmp(algo,"tbe") && strcmp(algo,"tbe-popcount") && strcmp(algo,"tbe-fast") && strcmp(algo,"tbe-sparse") && strcmp(algo,"fbp") && strcmp(algo,"fbp-table")){
+    fprintf(stderr,"Algo option must be one of \"tbe\", \"tbe-popcount\", \"tbe-fast\", \"tbe-sparse\", \"fbp\" or \"fbp-table\" (tbe ones followed by \",fbp\" for both)\n");
     Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
   }
   
+  if(strcmp(consensus_type,"majority") && strcmp(consensus_type,"extended")){
+    fprintf(stderr,"Consensus type must be one of \"majority\" or \"extended\"\n");
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+
+  /* the split table needs every tree (branch lengths of the consensus, counts of fbp-table) */
+  if(dedup && (!strcmp(algo,"fbp-table") || consensus_out != NULL)){
+    fprintf(stderr,"Warning: --dedup is ignored with %s: every bootstrap tree is analyzed\n", (consensus_out != NULL ? "--consensus" : "-a fbp-table"));
+    dedup = 0;
+  }
+
+  if(strcmp(hist_format,"tsv") && strcmp(hist_format,"bin")){
+    fprintf(stderr,"Histogram format must be one of \"tsv\" or \"bin\"\n");
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+
+  if(strcmp(count_format,"tsv") && strcmp(count_format,"bin")){
+    fprintf(stderr,"Count format must be one of \"tsv\" or \"bin\"\n");
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+
+  if(batch < 1){
+    fprintf(stderr,"Batch option must be a positive number of trees\n");
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+
+  for(simd_level = TBE_SIMD_AUTO; simd_level <= TBE_SIMD_AVX512; simd_level++){
+    if(!strcmp(simd, tbe_simd_name(simd_level))) break;
+  }
+  if(simd_level > TBE_SIMD_AVX512){
+    fprintf(stderr,"SIMD option must be one of \"auto\", \"scalar\", \"avx2\" or \"avx512\"\n");
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+  if((simd_level = tbe_simd_select(simd_level)) == -1){
+    fprintf(stderr,"SIMD kernel %s is not supported by this cpu\n", simd);
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+
   if (argc < optind || input_tree == NULL || boot_trees == NULL){
     fprintf(stderr,"An option is missing\n");
     usage(stderr,argv[0]);
@@ -229,6 +364,22 @@ int main (int argc, char* argv[]) {
     }
   } else stat_file = NULL;
 
+  if(hist_out != NULL){
+    hist_file = fopen(hist_out, (strcmp(hist_format,"bin") ? "w" : "wb"));
+    if(hist_file == NULL){
+      fprintf(stderr,"File %s not found or not writable. Aborting.\n", hist_out);
+      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+    }
+  }
+
+  if(count_out != NULL){
+    count_file = fopen(count_out, (strcmp(count_format,"bin") ? "w" : "wb"));
+    if(count_file == NULL){
+      fprintf(stderr,"File %s not found or not writable. Aborting.\n", count_out);
+      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+    }
+  }
+
   /* writing the output tree to the file given on the commandline */
   if(out_tree == NULL){
     output_file = stdout;
@@ -249,8 +400,24 @@ int main (int argc, char* argv[]) {
     }
   }
 
+
+  if(out_fbp_tree != NULL && with_fbp){
+    output_fbp_file = fopen(out_fbp_tree,"w");
+    if(output_fbp_file == NULL){
+      fprintf(stderr,"File %s not found or not writable. Aborting.\n", out_fbp_tree);
+      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+    }
+  }
+
+  if(consensus_out != NULL){
+    consensus_file = fopen(consensus_out,"w");
+    if(consensus_file == NULL){
+      fprintf(stderr,"File %s not found or not writable. Aborting.\n", consensus_out);
+      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+    }
+  }
   
-  if(!quiet) printOptions(stderr, input_tree, boot_trees, out_tree, out_raw_tree, stat_out, algo, num_threads, quiet, dist_cutoff, count_per_branch);
+  if(!quiet) printOptions(stderr, input_tree, boot_trees, out_tree, out_raw_tree, stat_out, algo, num_threads, quiet, dist_cutoff, count_per_branch, consensus_out, consensus_type, (char*)tbe_simd_name(simd_level));
 
   intree_file = fopen(input_tree,"r");
   if (intree_file == NULL) {
@@ -266,19 +433,31 @@ int main (int argc, char* argv[]) {
   }
 
   char *big_string = (char*) calloc(treefilesize+1, sizeof(char)); 
-  retcode = copy_nh_stream_into_str(intree_file, big_string);
-  if (retcode != 1) { 
+  char** taxname_lookup_table = NULL;
+  ref_trees = (Tree**) malloc(max_refs * sizeof(Tree*));
+  /* and then feed this string to the parser, for each tree of the file */
+  while(copy_nh_stream_into_str(intree_file, big_string)){
+    if(nb_refs >= max_refs){
+      max_refs *= 2;
+      ref_trees = realloc(ref_trees, max_refs * sizeof(Tree*));
+    }
+    ref_trees[nb_refs] = complete_parse_nh(big_string, &taxname_lookup_table); /* sets taxname_lookup_table en passant */
+    if(ref_trees[nb_refs] == NULL || ref_trees[nb_refs]->nb_taxa != ref_trees[0]->nb_taxa){
+      fprintf(stderr,"Reference tree %d is not a correct NH tree on the taxa of the first reference tree! Aborting.\n", nb_refs);
+      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+    }
+    nb_refs++;
+  }
+  if (nb_refs == 0) { 
     fprintf(stderr,"Unexpected EOF while parsing the reference tree! Aborting.\n"); 
     Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
   }
   fclose(intree_file);
-
-  /* and then feed this string to the parser */
-  char** taxname_lookup_table = NULL;
-  ref_tree  = complete_parse_nh(big_string, &taxname_lookup_table); /* sets taxname_lookup_table en passant */
-  if(out_raw_tree !=NULL){
-    ref_raw_tree  = complete_parse_nh(big_string, &taxname_lookup_table); /* sets taxname_lookup_table en passant */
+  if(!strncmp(algo,"tbe",3) && ref_trees[0]->nb_taxa > TBE_MAX_TAXA){
+    fprintf(stderr,"The reference tree has %d taxa: -a %s is limited to %d taxa (use -a fbp). Aborting.\n", ref_trees[0]->nb_taxa, algo, TBE_MAX_TAXA);
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
   }
+  if(!quiet && nb_refs > 1) fprintf(stderr,"Num reference trees: %d\n",nb_refs);
 
 
   /***********************************************************************/
@@ -314,18 +493,73 @@ int main (int argc, char* argv[]) {
 
   if(!quiet)  fprintf(stderr,"Num trees: %d\n",num_trees);
 
-  if(!strcmp(algo,"tbe")){
-    tbe(ref_tree, ref_raw_tree, alt_tree_strings, taxname_lookup_table, stat_file, num_trees, quiet, dist_cutoff, count_per_branch);
+  /* the bootstrap splits are counted while computing the supports, only if needed */
+  if(!strcmp(algo,"fbp-table") || consensus_out != NULL){
+    st = new_split_table(ref_trees[0]->nb_taxa, 64*num_threads, consensus_out != NULL);
+  }
+
+  if(!strncmp(algo,"tbe",3)){
+    if(!strcmp(algo,"tbe-popcount")) kernel = TBE_KERNEL_POPCOUNT;
+    else if(!strcmp(algo,"tbe-fast")) kernel = TBE_KERNEL_FAST;
+    else if(!strcmp(algo,"tbe-sparse")) kernel = TBE_KERNEL_SPARSE;
+    else if(contract) kernel = TBE_KERNEL_CONTRACT;
+    else kernel = (low_mem ? TBE_KERNEL_COLUMNS : TBE_KERNEL_AUTO);
+    if(output_raw_file != NULL) mean_dist = (double**) calloc(nb_refs, sizeof(double*));
+    if(with_fbp) nb_found = (int**) calloc(nb_refs, sizeof(int*));
+    for(i_ref=0; i_ref<nb_refs; i_ref++){
+      if(mean_dist != NULL) mean_dist[i_ref] = (double*) calloc(ref_trees[i_ref]->nb_edges, sizeof(double));
+      if(nb_found != NULL) nb_found[i_ref] = (int*) calloc(ref_trees[i_ref]->nb_edges, sizeof(int));
+    }
+    tbe_options options = {.stat_file = stat_file, .hist_file = hist_file, .hist_binary = !strcmp(hist_format,"bin"),
+			   .count_file = count_file, .count_binary = !strcmp(count_format,"bin"), .count_per_branch = count_per_branch,
+			   .dist_cutoff = dist_cutoff, .quiet = quiet, .kernel = kernel, .batch = batch, .huge_pages = huge_pages,
+			   .cache_mem = cache_mem, .dedup = dedup};
+    tbe(ref_trees, nb_refs, mean_dist, nb_found, alt_tree_strings, taxname_lookup_table, num_trees, &options, st);
+    /* each reference tree is written with each kind of annotation in turn */
+    for(i_ref=0; i_ref<nb_refs; i_ref++){
+      write_nh_tree(ref_trees[i_ref], output_file);
+      if(mean_dist != NULL){
+	set_raw_names(ref_trees[i_ref], mean_dist[i_ref], num_trees);
+	write_nh_tree(ref_trees[i_ref], output_raw_file);
+	free(mean_dist[i_ref]);
+      }
+      if(nb_found != NULL){
+	set_fbp_supports(ref_trees[i_ref], nb_found[i_ref], num_trees);
+	write_nh_tree(ref_trees[i_ref], (output_fbp_file != NULL ? output_fbp_file : output_file));
+	free(nb_found[i_ref]);
+      }
+    }
+    free(mean_dist);
+    free(nb_found);
   }else{
-    fbp(ref_tree, alt_tree_strings, taxname_lookup_table, num_trees, quiet);
+    /* the raw tree of fbp is the reference tree itself */
+    for(i_ref=0; i_ref<nb_refs && output_raw_file != NULL; i_ref++) write_nh_tree(ref_trees[i_ref], output_raw_file);
+    if(!strcmp(algo,"fbp-table")){
+      fbp_table(ref_trees, nb_refs, alt_tree_strings, taxname_lookup_table, num_trees, quiet, st);
+    }else{
+      fbp(ref_trees, nb_refs, alt_tree_strings, taxname_lookup_table, num_trees, quiet, dedup, st);
+    }
+    for(i_ref=0; i_ref<nb_refs; i_ref++) write_nh_tree(ref_trees[i_ref], output_file);
   }
-  write_nh_tree(ref_tree, output_file);
-  if(output_raw_file!=NULL && ref_raw_tree!=NULL){
-    write_nh_tree(ref_raw_tree, output_raw_file);
+
+  if(consensus_out != NULL){
+    consensus = consensus_tree(st, (strcmp(consensus_type,"extended") ? CONSENSUS_MAJORITY : CONSENSUS_EXTENDED), &taxname_lookup_table);
+    if(consensus == NULL){
+      fprintf(stderr,"Impossible to build the consensus tree. Aborting.\n");
+      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+    }
+    write_nh_tree(consensus, consensus_file);
+    fclose(consensus_file);
+    free_tree(consensus);
   }
+  if(st != NULL) free_split_table(st);
 
   fclose(output_file);
+  if(output_raw_file != NULL) fclose(output_raw_file);
+  if(output_fbp_file != NULL) fclose(output_fbp_file);
   if(stat_file != NULL) fclose(stat_file);
+  if(hist_file != NULL) fclose(hist_file);
+  if(count_file != NULL) fclose(count_file);
   // FREEING STUFF
   free(big_string);
 
@@ -336,291 +570,9 @@ int main (int argc, char* argv[]) {
   free(alt_tree_strings);
 
   /* we also have to free the taxname lookup table */
-  for(i=0; i < ref_tree->nb_taxa; i++) free(taxname_lookup_table[i]); /* freeing (char*)'s */
+  for(i=0; i < ref_trees[0]->nb_taxa; i++) free(taxname_lookup_table[i]); /* freeing (char*)'s */
   free(taxname_lookup_table); /* which is a (char**) */
-  free_tree(ref_tree);
+  for(i_ref=0; i_ref<nb_refs; i_ref++) free_tree(ref_trees[i_ref]);
+  free(ref_trees);
   return 0;
 }
-
-
-void fbp(Tree *ref_tree, char **alt_tree_strings,char** taxname_lookup_table, int num_trees, int quiet){
-  int j;
-  Tree *alt_tree;
-  int i_tree,i;
-  short unsigned* nb_found = malloc(ref_tree->nb_edges * sizeof(short unsigned));
-  double support;
-
-  for(i=0; i< ref_tree->nb_edges; i++){
-    nb_found[i] = 0;
-  }
-
- 
-#pragma omp parallel for private( j, alt_tree, support) shared(nb_found, ref_tree, alt_tree_strings, taxname_lookup_table, quiet, num_trees) schedule(dynamic)
-  for(i_tree=0; i_tree< num_trees; i_tree++){
-    if(!quiet) fprintf(stderr,"New bootstrap tree : %d\n",i_tree);
-    alt_tree = complete_parse_nh(alt_tree_strings[i_tree], &taxname_lookup_table);
-    
-    if (alt_tree == NULL) {
-      fprintf(stderr,"Not a correct NH tree (%d). Skipping.\n%s\n",i_tree,alt_tree_strings[i_tree]);
-      continue; /* some files maybe not containing trees */
-    }
-    if (alt_tree->nb_taxa != ref_tree->nb_taxa) {
-      fprintf(stderr,"This tree doesn't have the same number of taxa as the reference tree. Skipping.\n");
-      continue; /* some files maybe not containing trees */
-    }
-
-    // We initialize the reference edge hashmap
-    bitset_hashmap *hm = new_bitset_hashmap(alt_tree->nb_edges*2, 0.75);
-
-    /****************************************************/
-    /*     comparison of the bipartitions, FBP method   */
-    /****************************************************/
-    for (j = 0; j <  alt_tree->nb_edges; j++) {
-      bitset_hashmap_putvalue(hm,alt_tree->a_edges[j]->hashtbl[1],alt_tree->nb_taxa,j);
-    }
-    for (j = 0; j <  ref_tree->nb_edges; j++) {
-      // We query the hashmap to see if the edge is present, and then get its reference index
-      int refindex = bitset_hashmap_value(hm, ref_tree->a_edges[j]->hashtbl[1], ref_tree->nb_taxa);
-      if (refindex>-1){
-	      #pragma omp atomic update
-	      nb_found[j]++;
-      }
-    }
-    free_tree(alt_tree);
-    free_bitset_hashmap(hm);
-  }
-
-  #pragma omp barrier
-
-  if(num_trees != 0) {
-    for (i = 0; i <  ref_tree->nb_edges; i++) {
-      if(ref_tree->a_edges[i]->right->nneigh == 1) { continue; }
-      /* the bootstrap value for a branch is inscribed as the name of its descendant (always right side of the edge, by convention) */
-      if(ref_tree->a_edges[i]->right->name) free(ref_tree->a_edges[i]->right->name); /* clear name if existing */
-      ref_tree->a_edges[i]->right->name = (char*) malloc(16 * sizeof(char));
-      support   = (double) nb_found[i] * 1.0 / num_trees;
-      sprintf(ref_tree->a_edges[i]->right->name, "%.6f", support);
-      ref_tree->a_edges[i]->branch_support = support;
-    }
-  }
-  free(nb_found);
-}
-
-void tbe(Tree *ref_tree, Tree *ref_raw_tree, char **alt_tree_strings,char** taxname_lookup_table, FILE *stat_file, int num_trees, int quiet, double dist_cutoff, int count_per_branch){
-  short unsigned** c_matrix;
-  short unsigned** i_matrix;
-  short unsigned** hamming;
-  short unsigned* min_dist_edge; /* array of edge ids corresponding to min Hamming distances */
-  short unsigned* min_dist;
-  int i,j;
-  int m = ref_tree->nb_edges;
-  int n = ref_tree->nb_taxa;
-  Tree *alt_tree;
-  int i_tree;
-  int *dist_accu      = (int*) calloc(m,sizeof(int)); /* array of distance sums, one per branch. Initialized to 0. */
-  int **dist_accu_tmp;
-  double *moved_species_counts;  /* array of average branch rate in which each taxon moves */
-  int *moved_species; /* array of number of branches in which each taxon moves, in one bootstrap tree: initialized at each bootstrap tree */
-  /** Max number of branches we can see in the bootstrap tree: If it has no multifurcation : binary tree--> ntax*2-2 (if rooted...) */
-  int max_branches_boot = ref_tree->nb_taxa*2-2;
-  
-  /* array a[i][j] of number of bootstrap tree from which each taxon j moves around the branch i and that are closer than given distance */
-  int **moved_species_counts_per_branch;
-
-  if(stat_file != NULL && count_per_branch){
-    moved_species_counts_per_branch = (int**) calloc(m,sizeof(int*));
-    for(i=0;i<m;i++){
-      moved_species_counts_per_branch[i]  = (int*) calloc(n,sizeof(int));
-    }
-  }
-  dist_accu_tmp = (int**) calloc(num_trees,sizeof(int*)); /* array of distance sums, one per boot tree and branch. Initialized to 0. */
-  for(i_tree=0; i_tree< num_trees; i_tree++){
-    dist_accu_tmp[i_tree]  = (int*) calloc(m,sizeof(int)); /* array of distance sums, one per branch. Initialized to 0. */
-  }
-  moved_species_counts = (double*) calloc(m,sizeof(double)); /* array of average branch rate in which each taxon moves */
-
-#pragma omp parallel for private(min_dist,c_matrix,i_matrix,hamming,min_dist_edge, i, alt_tree, moved_species) shared(max_branches_boot, ref_tree, alt_tree_strings, dist_accu_tmp, taxname_lookup_table, m, moved_species_counts, moved_species_counts_per_branch) schedule(dynamic)
-  for(i_tree=0; i_tree< num_trees; i_tree++){
-    if(!quiet) fprintf(stderr,"New bootstrap tree : %d\n",i_tree);
-    alt_tree = complete_parse_nh(alt_tree_strings[i_tree], &taxname_lookup_table);
-    
-    if (alt_tree == NULL) {
-      fprintf(stderr,"Not a correct NH tree (%d). Skipping.\n%s\n",i_tree,alt_tree_strings[i_tree]);
-      continue; /* some files maybe not containing trees */
-    }
-    if (alt_tree->nb_taxa != n) {
-      fprintf(stderr,"This tree doesn't have the same number of taxa as the reference tree. Skipping.\n");
-      continue; /* some files maybe not containing trees */
-    }
-
-    /* resetting the arrays that need be reset. By construction of the post-order traversal,
-       the other arrays (i_matrix, c_matrix and hamming) need not be reset. */
-    reset_matrices(n, m, max_branches_boot, &c_matrix, &i_matrix, &hamming, &min_dist,&min_dist_edge);
-
-    /****************************************************/
-    /* comparison of the bipartitions, Transfer method */
-    /****************************************************/		  
-    /* calculation of the C and I matrices (see Brehelin/Gascuel/Martin) */
-    update_all_i_c_post_order_ref_tree(ref_tree, alt_tree, i_matrix, c_matrix);
-    update_all_i_c_post_order_boot_tree(ref_tree, alt_tree, i_matrix, c_matrix, hamming, min_dist, min_dist_edge);
-
-    /* Looking at number of times each taxon moves around low distance branches */
-    moved_species = (int*) calloc(n,sizeof(int));
-    int nb_branches_close=0;
-    int j;
-    for(i=0;i<m;i++){
-      Edge* re = ref_tree->a_edges[i];
-      if (re->right->nneigh == 1) continue;
-      Edge* be = alt_tree->a_edges[min_dist_edge[i]];
-
-      double norm  = ((double)min_dist[i]) * 1.0 / (((double)re->topo_depth) - 1.0);
-      int mindepth = (int)(ceil(1.0/dist_cutoff + 1.0));
-      int* sm = species_to_move(re, be, min_dist[i], n);
-      for(j=0;j<min_dist[i];j++){
-	if (norm <= dist_cutoff && re->topo_depth >= mindepth ){
-	  moved_species[sm[j]]++;
-	}
-	if(stat_file != NULL && count_per_branch){
-          #pragma omp atomic update
-	  moved_species_counts_per_branch[i][sm[j]]++;
-	}
-      }
-      if (norm <= dist_cutoff && re->topo_depth >= mindepth ){
-	nb_branches_close++;
-      }
-      free(sm);
-    }
-
-    /* output, just to see */
-    for (i = 0; i < m; i++) {
-      /* Just backup for pvalue computation */
-      dist_accu_tmp[i_tree][i] = min_dist[i];
-    }
-    for (i=0; i < n; i++){
-      #pragma omp atomic update
-      moved_species_counts[i] += ((double)moved_species[i])*1.0/((double)nb_branches_close);
-    }
-
-    free_matrices(m, &c_matrix, &i_matrix, &hamming, &min_dist,&min_dist_edge);
-    free_tree(alt_tree);
-    free(moved_species);
-  }
-
-  #pragma omp barrier
-
-  for (i = 0; i < m; i++){
-    for(i_tree=0; i_tree < num_trees; i_tree++){
-      dist_accu[i] += dist_accu_tmp[i_tree][i];
-    }
-  }
-
-  int card;
-  double bootstrap_val, avg_dist;
-		
-  if(num_trees != 0) {
-    if(stat_file != NULL)
-      fprintf(stat_file,"EdgeId\tDepth\tMeanMinDist\n");
-
-    /* OUTPUT FINAL STATISTICS and UPDATE REF TREE WITH BOOTSTRAP VALUES */
-    for (i = 0; i <  ref_tree->nb_edges; i++) {
-      if(ref_tree->a_edges[i]->right->nneigh == 1) { continue; }
-
-      /* the bootstrap value for a branch is inscribed as the name of its descendant (always right side of the edge, by convention) */
-      if(ref_tree->a_edges[i]->right->name) free(ref_tree->a_edges[i]->right->name); /* clear name if existing */
-      ref_tree->a_edges[i]->right->name = (char*) malloc(16 * sizeof(char));
-      card = ref_tree->a_edges[i]->hashtbl[1]->num_items;
-      if (card > n/2) { card = n - card; }	  
-      avg_dist      = (double) dist_accu[i] * 1.0 / num_trees;
-      bootstrap_val = (double) 1.0 - avg_dist * 1.0 / (1.0 * ref_tree->a_edges[i]->topo_depth-1.0);
-
-      if(stat_file != NULL)
-	fprintf(stat_file,"%d\t%d\t%f\n", i, (ref_tree->a_edges[i]->topo_depth), avg_dist);
-
-      sprintf(ref_tree->a_edges[i]->right->name, "%.6f", bootstrap_val);
-
-      ref_tree->a_edges[i]->branch_support = bootstrap_val;
-      
-      if(ref_raw_tree!=NULL){
-	/* the bootstrap value for a branch is inscribed as the name of its descendant as id|avgdist|depth */
-	if(ref_raw_tree->a_edges[i]->right->name) free(ref_raw_tree->a_edges[i]->right->name); /* clear name if existing */
-	ref_raw_tree->a_edges[i]->right->name = (char*) malloc(16 * sizeof(char));
-	card = ref_raw_tree->a_edges[i]->hashtbl[1]->num_items;
-	if (card > n/2) { card = n - card; }
-	avg_dist      = (double) dist_accu[i] * 1.0 / num_trees;
-	sprintf(ref_raw_tree->a_edges[i]->right->name, "%d|%.6f|%d", ref_raw_tree->a_edges[i]->id, avg_dist,ref_tree->a_edges[i]->topo_depth);
-      }
-    }
-
-    if(stat_file != NULL){
-      fprintf(stat_file,"Taxon\ttIndex\n");
-      for(i=0; i<n;i++){
-	fprintf(stat_file,"%s\t%f\n", taxname_lookup_table[i], moved_species_counts[i]*100.0 / ((double)num_trees));
-      }
-    }
-  }
-
-  if(stat_file != NULL && count_per_branch){
-    fprintf(stat_file,"Edge\tSupport");
-    for(i=0; i<n;i++){
-      fprintf(stat_file,"\t%s", taxname_lookup_table[i]);
-    }
-    fprintf(stat_file,"\n");
-    for(i=0; i<m;i++){
-      if(ref_tree->a_edges[i]->right->nneigh == 1) { continue; }
-      fprintf(stat_file,"%d\t%s", i,ref_tree->a_edges[i]->right->name);
-      for(j=0;j<n;j++){
-	fprintf(stat_file,"\t%f",moved_species_counts_per_branch[i][j]*1.0/num_trees);
-      }
-      fprintf(stat_file,"\n");
-    }
-    for(i=0;i<m;i++){
-      free(moved_species_counts_per_branch[i]);
-    }
-    free(moved_species_counts_per_branch);
-  }
-  
-  free(dist_accu);
-  for(i_tree=0; i_tree < num_trees;i_tree++){
-    free(dist_accu_tmp[i_tree]);
-  }
-  free(dist_accu_tmp);
-  free(moved_species_counts);
-}
-
-
-
-// Returns the list of id of species to move to go from one branch to the other
-// Its length should correspond to given dist
-// If not, exit with an error
-int* species_to_move(Edge* re, Edge* be, int dist, int nb_taxa) {
-  int i;
-  int maxnb = dist;
-  if(nb_taxa-dist >= dist) maxnb=nb_taxa-dist;
-  int *diff = calloc(maxnb,sizeof(int));
-  int *equ  = calloc(maxnb,sizeof(int));
-  int nbdiff=0, nbequ=0;
-
-  for(i = 0; i < nb_taxa; i++) {
-    if(lookup_id(re->hashtbl[1],i) != lookup_id(be->hashtbl[1],i)){
-      diff[nbdiff]=i;
-      nbdiff++;
-    } else {
-      equ[nbequ] = i;
-      nbequ++;
-    }
-  }
-  if(nbdiff < nbequ){
-    if(nbdiff != dist){
-      fprintf(stderr,"Length of moved species array (%d) is not equal to the minimum distance found (%d)\n", nbdiff, dist);
-      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
-    }
-    free(equ);
-    return diff;
-  }
-  if(nbequ != dist){
-      fprintf(stderr,"Length of moved species array (%d) is not equal to the minimum distance found (%d)\n", nbequ, dist);
-      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
-    }
-  free(diff);
-  return equ;
-}
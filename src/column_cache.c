@@ -0,0 +1,162 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "column_cache.h"
+#include "workspace.h"
+
+static int padded(int length, size_t elt_size){
+  int per_line = WORKSPACE_ALIGN / elt_size;
+  return ((length + per_line - 1) / per_line) * per_line;
+}
+
+column_cache* new_column_cache(int nb_rows, size_t max_bytes, int nb_shards){
+  int i, j, nb_slots;
+  size_t slot_bytes = padded(nb_rows, sizeof(short unsigned)) * sizeof(short unsigned) + padded(nb_rows, sizeof(uint32_t)) * sizeof(uint32_t);
+  column_cache *cc;
+  column_shard *sh;
+  long total = max_bytes / slot_bytes;
+
+  if(total < 1) return NULL;
+  cc = malloc(sizeof(column_cache));
+  cc->nb_rows = nb_rows;
+  cc->column_stride = padded(nb_rows, sizeof(short unsigned));
+  cc->keys_stride = padded(nb_rows, sizeof(uint32_t));
+  cc->slot_bytes = slot_bytes;
+  /* at least one slot per shard */
+  cc->nb_shards = 1;
+  while(cc->nb_shards < nb_shards && 2 * cc->nb_shards <= total) cc->nb_shards <<= 1;
+  cc->shards = malloc(cc->nb_shards * sizeof(column_shard));
+  nb_slots = total / cc->nb_shards;
+  for(i=0; i<cc->nb_shards; i++){
+    sh = &(cc->shards[i]);
+    sh->nb_slots = nb_slots;
+    sh->nb_used = 0;
+    sh->hand = 0;
+    for(sh->bucket_mask = 1; sh->bucket_mask < 2 * nb_slots; sh->bucket_mask <<= 1);
+    sh->buckets = malloc(sh->bucket_mask * sizeof(int));
+    for(j=0; j<sh->bucket_mask; j++) sh->buckets[j] = -1;
+    sh->bucket_mask--;
+    sh->next = malloc(nb_slots * sizeof(int));
+    sh->fps = malloc(nb_slots * sizeof(fingerprint_t));
+    sh->referenced = calloc(nb_slots, sizeof(unsigned char));
+    sh->data = aligned_malloc(nb_slots * slot_bytes, 0);
+    sh->lookups = sh->hits = 0;
+    omp_init_lock(&(sh->lock));
+  }
+  return cc;
+}
+
+void free_column_cache(column_cache *cc){
+  int i;
+  for(i=0; i<cc->nb_shards; i++){
+    free(cc->shards[i].buckets);
+    free(cc->shards[i].next);
+    free(cc->shards[i].fps);
+    free(cc->shards[i].referenced);
+    aligned_free(cc->shards[i].data);
+    omp_destroy_lock(&(cc->shards[i].lock));
+  }
+  free(cc->shards);
+  free(cc);
+}
+
+static inline column_shard* column_cache_shard(column_cache *cc, fingerprint_t fp){
+  return &(cc->shards[fp.hi & (cc->nb_shards-1)]);
+}
+
+/* slot of fp in the shard, -1 if absent. The caller must hold the lock */
+static int column_shard_find(column_shard *sh, fingerprint_t fp){
+  int slot;
+  for(slot = sh->buckets[fp.lo & sh->bucket_mask]; slot != -1; slot = sh->next[slot]){
+    if(fingerprint_equals(sh->fps[slot], fp)) return slot;
+  }
+  return -1;
+}
+
+int column_cache_get(column_cache *cc, fingerprint_t fp, short unsigned *column, uint32_t *min_key, int base){
+  int k, slot;
+  column_shard *sh = column_cache_shard(cc, fp);
+  const short unsigned *cached_column;
+  const uint32_t *cached_keys;
+
+  omp_set_lock(&(sh->lock));
+  sh->lookups++;
+  slot = column_shard_find(sh, fp);
+  if(slot != -1){
+    sh->hits++;
+    sh->referenced[slot] = 1;
+    cached_column = (const short unsigned*)(sh->data + slot * cc->slot_bytes);
+    cached_keys = (const uint32_t*)(cached_column + cc->column_stride);
+    memcpy(column, cached_column, cc->nb_rows * sizeof(short unsigned));
+    for(k=0; k<cc->nb_rows; k++){
+      if(cached_keys[k] + base < min_key[k]) min_key[k] = cached_keys[k] + base;
+    }
+  }
+  omp_unset_lock(&(sh->lock));
+  return slot != -1;
+}
+
+void column_cache_put(column_cache *cc, fingerprint_t fp, const short unsigned *column, const uint32_t *keys){
+  int slot, *prev;
+  column_shard *sh = column_cache_shard(cc, fp);
+  short unsigned *cached_column;
+
+  omp_set_lock(&(sh->lock));
+  /* another thread may have stored it in the meantime */
+  if(column_shard_find(sh, fp) != -1){
+    omp_unset_lock(&(sh->lock));
+    return;
+  }
+  if(sh->nb_used < sh->nb_slots){
+    slot = sh->nb_used++;
+  } else {
+    /* CLOCK: the first slot not referenced since the last pass of the hand */
+    while(sh->referenced[sh->hand]){
+      sh->referenced[sh->hand] = 0;
+      sh->hand = (sh->hand + 1) % sh->nb_slots;
+    }
+    slot = sh->hand;
+    sh->hand = (sh->hand + 1) % sh->nb_slots;
+    for(prev = &(sh->buckets[sh->fps[slot].lo & sh->bucket_mask]); *prev != slot; prev = &(sh->next[*prev]));
+    *prev = sh->next[slot];
+  }
+  sh->fps[slot] = fp;
+  sh->referenced[slot] = 0;
+  sh->next[slot] = sh->buckets[fp.lo & sh->bucket_mask];
+  sh->buckets[fp.lo & sh->bucket_mask] = slot;
+  cached_column = (short unsigned*)(sh->data + slot * cc->slot_bytes);
+  memcpy(cached_column, column, cc->nb_rows * sizeof(short unsigned));
+  memcpy(cached_column + cc->column_stride, keys, cc->nb_rows * sizeof(uint32_t));
+  omp_unset_lock(&(sh->lock));
+}
+
+void column_cache_stats(column_cache *cc, long *lookups, long *hits){
+  int i;
+  *lookups = *hits = 0;
+  for(i=0; i<cc->nb_shards; i++){
+    *lookups += cc->shards[i].lookups;
+    *hits += cc->shards[i].hits;
+  }
+}
@@ -0,0 +1,82 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _COLUMN_CACHE_H_
+#define _COLUMN_CACHE_H_
+
+#include <stdint.h>
+#include <omp.h>
+#include "fingerprint.h"
+
+/*
+  Cache of the intersection columns of the bootstrap subtrees, shared by all the threads.
+  For a given reference tree, the column of a boot edge only depends on its clade, and the min keys
+  of the edges of its subtree (dist << TBE_RANK_BITS | rank, the ranks being relative to the first 
+  edge of the subtree in the standard post-order) only depend on the subtree: an entry is identified 
+  by the 128 bits fingerprint of the ordered subtree, and stores both, so that the column kernel 
+  can skip the whole subtree when it is found again in another bootstrap tree.
+
+  The memory is bounded: the number of entries is fixed when the cache is created, and the entries
+  are replaced with the CLOCK algorithm (an entry found since the hand last passed it gets a second chance).
+  The cache is split into shards, each with its own lock, its own entries and its own hand.
+*/
+
+typedef struct column_shard{
+  int nb_slots;
+  int nb_used;
+  int hand;                /* next slot examined by the CLOCK */
+  int bucket_mask;
+  int *buckets;            /* first slot of each bucket, -1 if empty */
+  int *next;               /* next slot in the same bucket */
+  fingerprint_t *fps;
+  unsigned char *referenced;
+  char *data;              /* column and keys of each slot */
+  long lookups;
+  long hits;
+  omp_lock_t lock;
+} column_shard;
+
+typedef struct column_cache{
+  int nb_rows;             /* length of the columns */
+  int column_stride;       /* padded lengths, in elements */
+  int keys_stride;
+  size_t slot_bytes;
+  int nb_shards;           /* power of 2 */
+  column_shard *shards;
+} column_cache;
+
+// Allocates a cache of columns of nb_rows elements, using at most max_bytes for the entries. 
+// Returns NULL if max_bytes cannot hold a single entry
+column_cache* new_column_cache(int nb_rows, size_t max_bytes, int nb_shards);
+void free_column_cache(column_cache *cc);
+// If the subtree of fingerprint fp is cached: copies its column into column, merges its keys 
+// (shifted by base, the rank of the first edge of the subtree) into min_key, and returns 1. Returns 0 otherwise
+int column_cache_get(column_cache *cc, fingerprint_t fp, short unsigned *column, uint32_t *min_key, int base);
+// Stores the column and the keys (relative ranks) of the subtree of fingerprint fp, replacing an old entry if needed
+void column_cache_put(column_cache *cc, fingerprint_t fp, const short unsigned *column, const uint32_t *keys);
+// Total number of lookups and hits
+void column_cache_stats(column_cache *cc, long *lookups, long *hits);
+
+#endif
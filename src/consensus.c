@@ -0,0 +1,189 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "consensus.h"
+
+/* Most frequent splits first. Ties are broken on the fingerprints, so that the greedy 
+   extended consensus does not depend on the insertion order of the trees */
+static int compare_split_entries(const void *e1, const void *e2){
+  const split_entry *s1 = *(split_entry* const*)e1;
+  const split_entry *s2 = *(split_entry* const*)e2;
+  if(s1->count != s2->count) return s2->count - s1->count;
+  if(s1->fp.hi != s2->fp.hi) return (s1->fp.hi < s2->fp.hi ? -1 : 1);
+  if(s1->fp.lo != s2->fp.lo) return (s1->fp.lo < s2->fp.lo ? -1 : 1);
+  return 0;
+}
+
+/* Largest clades first, so that a clade is always processed after the clades containing it */
+static int compare_split_sizes(const void *e1, const void *e2){
+  const split_entry *s1 = *(split_entry* const*)e1;
+  const split_entry *s2 = *(split_entry* const*)e2;
+  return s2->nb_items - s1->nb_items;
+}
+
+int compatible_splits(id_hash_table_t *a, id_hash_table_t *b){
+  /* the two canonical sides do not contain the taxon 0, so their complements always intersect:
+     the splits are compatible iff the sides are disjoint or nested */
+  int i, inter = 0, a_not_b = 0, b_not_a = 0;
+  for(i=0; i<nbchunks_bitarray; i++){
+    inter   |= ((a->bitarray[i] & b->bitarray[i]) != 0);
+    a_not_b |= ((a->bitarray[i] & ~b->bitarray[i]) != 0);
+    b_not_a |= ((b->bitarray[i] & ~a->bitarray[i]) != 0);
+    if(inter && a_not_b && b_not_a) return 0;
+  }
+  return 1;
+}
+
+/* growing string, to write the consensus in newick format */
+typedef struct newick_buffer{
+  char *str;
+  int len;
+  int capacity;
+} newick_buffer;
+
+static void newick_append(newick_buffer *b, const char *s){
+  int l = strlen(s);
+  while(b->len + l + 1 > b->capacity){
+    b->capacity *= 2;
+    b->str = realloc(b->str, b->capacity * sizeof(char));
+  }
+  strcpy(b->str + b->len, s);
+  b->len += l;
+}
+
+/* 
+   The nodes of the consensus are numbered as follows: 0..nb_taxa-1 are the taxa, 
+   nb_taxa..nb_taxa+nb_clades-1 are the chosen clades, and nb_taxa+nb_clades is the root.
+   first_child and next_sibling give the children of each node.
+*/
+static void newick_write_node(newick_buffer *b, int node, int *first_child, int *next_sibling, 
+			      split_entry **clades, split_table *st, char **taxname_lookup_table){
+  char tmp[64];
+  int child;
+  split_entry *e;
+
+  if(first_child[node] == -1){
+    newick_append(b, taxname_lookup_table[node]);
+    /* terminal branches are also in the table, as trivial splits */
+    e = split_table_get(st, canonical_fingerprint(st->keys, st->keys->keys[node], node == 0));
+  }else{
+    newick_append(b, "(");
+    for(child = first_child[node]; child != -1; child = next_sibling[child]){
+      newick_write_node(b, child, first_child, next_sibling, clades, st, taxname_lookup_table);
+      if(next_sibling[child] != -1) newick_append(b, ",");
+    }
+    e = clades[node - st->nb_taxa];
+    sprintf(tmp, ")%.6f", e->count * 1.0 / st->nb_trees);
+    newick_append(b, tmp);
+  }
+  sprintf(tmp, ":%f", (e != NULL && e->count > 0) ? e->brlen_sum / e->count : 0.0);
+  newick_append(b, tmp);
+}
+
+Tree* consensus_tree(split_table *st, int type, char*** taxname_lookup_table){
+  int i, j, t, nb_entries, nb_clades = 0, node, root;
+  split_entry **entries, **clades;
+  int *owner, *parent, *first_child, *last_child, *next_sibling;
+  newick_buffer b;
+  Tree *consensus;
+  unsigned long word;
+
+  if(!st->keep_splits) return NULL;
+
+  entries = split_table_entries(st, &nb_entries);
+  qsort(entries, nb_entries, sizeof(split_entry*), compare_split_entries);
+
+  /* choosing the non trivial splits of the consensus: at most nb_taxa-3 */
+  clades = malloc((st->nb_taxa > 3 ? st->nb_taxa - 3 : 1) * sizeof(split_entry*));
+  for(i=0; i<nb_entries && nb_clades < st->nb_taxa - 3; i++){
+    if(entries[i]->nb_items < 2 || entries[i]->nb_items > st->nb_taxa - 2) continue;
+    if(2 * entries[i]->count > st->nb_trees){
+      /* majority splits are always compatible with each other */
+      clades[nb_clades++] = entries[i];
+    }else if(type == CONSENSUS_EXTENDED){
+      for(j=0; j<nb_clades; j++){
+	if(!compatible_splits(entries[i]->split, clades[j]->split)) break;
+      }
+      if(j == nb_clades) clades[nb_clades++] = entries[i];
+    }else{
+      break; /* entries are sorted by count: no more majority splits */
+    }
+  }
+  free(entries);
+
+  /* building the hierarchy of clades: clades are processed from the largest to the smallest, and
+     owner[t] gives the smallest clade processed so far that contains taxon t. As the clades are 
+     compatible, the parent of a clade is the owner of any of its taxa. */
+  qsort(clades, nb_clades, sizeof(split_entry*), compare_split_sizes);
+  root = st->nb_taxa + nb_clades;
+  owner = malloc(st->nb_taxa * sizeof(int));
+  parent = malloc((root+1) * sizeof(int));
+  first_child = malloc((root+1) * sizeof(int));
+  last_child = malloc((root+1) * sizeof(int));
+  next_sibling = malloc((root+1) * sizeof(int));
+  for(t=0; t<st->nb_taxa; t++) owner[t] = root;
+  for(i=0; i<nb_clades; i++){
+    node = st->nb_taxa + i;
+    parent[node] = owner[first_id(clades[i]->split)];
+    for(j=0; j<nbchunks_bitarray; j++){
+      for(word = clades[i]->split->bitarray[j]; word; word &= word - 1){
+	owner[j * chunksize + __builtin_ctzl(word)] = node;
+      }
+    }
+  }
+  for(t=0; t<st->nb_taxa; t++) parent[t] = owner[t];
+
+  for(node=0; node<=root; node++){
+    first_child[node] = last_child[node] = next_sibling[node] = -1;
+  }
+  /* taxa first, then clades, so that the taxon 0 is the first child of the root */
+  for(node=0; node<root; node++){
+    if(first_child[parent[node]] == -1) first_child[parent[node]] = node;
+    else next_sibling[last_child[parent[node]]] = node;
+    last_child[parent[node]] = node;
+  }
+
+  b.capacity = 1024;
+  b.len = 0;
+  b.str = malloc(b.capacity * sizeof(char));
+  b.str[0] = '\0';
+  newick_append(&b, "(");
+  for(node = first_child[root]; node != -1; node = next_sibling[node]){
+    newick_write_node(&b, node, first_child, next_sibling, clades, st, *taxname_lookup_table);
+    if(next_sibling[node] != -1) newick_append(&b, ",");
+  }
+  newick_append(&b, ");");
+
+  consensus = complete_parse_nh(b.str, taxname_lookup_table);
+
+  free(b.str);
+  free(owner);
+  free(parent);
+  free(first_child);
+  free(last_child);
+  free(next_sibling);
+  free(clades);
+  return consensus;
+}
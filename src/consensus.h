@@ -0,0 +1,46 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _CONSENSUS_H_
+#define _CONSENSUS_H_
+
+#include "split_table.h"
+#include "tree.h"
+
+#define CONSENSUS_MAJORITY 0 /* splits present in more than half of the trees */
+#define CONSENSUS_EXTENDED 1 /* majority splits, then greedily the most frequent splits compatible with the ones already chosen */
+
+/* 
+   Builds a consensus tree of all the trees inserted in the split table.
+   The table must have been created with keep_splits, so that it knows the taxa of each split.
+   The support of each internal branch (written as the name of its descendant node) is the 
+   proportion of trees containing it, and its length is its average length over these trees.
+   Returns NULL if the table does not keep its splits.
+*/
+Tree* consensus_tree(split_table *st, int type, char*** taxname_lookup_table);
+// Returns true if the two canonical splits may coexist in the same tree
+int compatible_splits(id_hash_table_t *a, id_hash_table_t *b);
+
+#endif
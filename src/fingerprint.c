@@ -0,0 +1,170 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "fingerprint.h"
+
+/* splitmix64 generator: we do not use the global prng here, because the keys 
+   must not depend on (nor modify) the random state of the rest of the program */
+static uint64_t splitmix64_next(uint64_t *state){
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+fingerprint_keys* new_fingerprint_keys(int nb_taxa, uint64_t seed){
+  int i;
+  uint64_t state = seed;
+  fingerprint_keys *keys = malloc(sizeof(fingerprint_keys));
+  keys->nb_taxa = nb_taxa;
+  keys->keys = malloc(nb_taxa*sizeof(fingerprint_t));
+  keys->all.lo = 0;
+  keys->all.hi = 0;
+  for(i=0; i<nb_taxa; i++){
+    keys->keys[i].lo = splitmix64_next(&state);
+    keys->keys[i].hi = splitmix64_next(&state);
+    keys->all.lo ^= keys->keys[i].lo;
+    keys->all.hi ^= keys->keys[i].hi;
+  }
+  return keys;
+}
+
+void free_fingerprint_keys(fingerprint_keys *keys){
+  free(keys->keys);
+  free(keys);
+}
+
+fingerprint_t fingerprint_id_hashtable(fingerprint_keys *keys, id_hash_table_t *h){
+  fingerprint_t fp = {0, 0};
+  int chunk, id;
+  unsigned long word;
+  for(chunk = 0; chunk < nbchunks_bitarray; chunk++){
+    word = h->bitarray[chunk];
+    while(word){
+      id = chunk * chunksize + __builtin_ctzl(word);
+      if(id >= keys->nb_taxa) break; /* junk bits of the last chunk */
+      fp.lo ^= keys->keys[id].lo;
+      fp.hi ^= keys->keys[id].hi;
+      word &= word - 1;
+    }
+  }
+  return fp;
+}
+
+fingerprint_t canonical_fingerprint(fingerprint_keys *keys, fingerprint_t fp, int has_taxon0){
+  if(has_taxon0){
+    fp.lo ^= keys->all.lo;
+    fp.hi ^= keys->all.hi;
+  }
+  return fp;
+}
+
+/* fingerprint of the clade below current (seen from orig), stored at the index of the edge (current,orig) */
+static fingerprint_t tree_edge_fingerprints_recur(Node *current, Node *orig, fingerprint_keys *keys, fingerprint_t *out){
+  int i, n = current->nneigh;
+  int curr_to_orig = (orig ? dir_a_to_b(current, orig) : -1);
+  fingerprint_t fp = {0, 0}, child;
+  Edge *br;
+
+  if(curr_to_orig == -1){
+    for(i=0; i<n; i++) tree_edge_fingerprints_recur(current->neigh[i], current, keys, out);
+    return fp;
+  }
+
+  br = current->br[curr_to_orig];
+  if(n == 1){
+    /* the hashtable of a terminal edge holds the id of its taxon */
+    fp = keys->keys[first_id(br->hashtbl[1])];
+  }else{
+    for(i=1; i<n; i++){
+      child = tree_edge_fingerprints_recur(current->neigh[(curr_to_orig+i)%n], current, keys, out);
+      fp.lo ^= child.lo;
+      fp.hi ^= child.hi;
+    }
+  }
+  /* the side of current contains taxon 0 iff taxon 0 is on the right of br and current is the right node */
+  out[br->id] = canonical_fingerprint(keys, fp, lookup_id(br->hashtbl[1], 0) == (current == br->right));
+  return fp;
+}
+
+void tree_edge_fingerprints(Tree *tree, fingerprint_keys *keys, fingerprint_t *out){
+  tree_edge_fingerprints_recur(tree->node0, NULL, keys, out);
+}
+
+/* bits of a 64 bits word mixed, so that the sum of the hashes of different sets of splits does not cancel */
+static inline uint64_t fingerprint_mix(uint64_t z){
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/* fingerprint of the clade below current (seen from orig), its number of taxa and whether it contains 
+   taxon 0. Adds the hash of the split of the edge to out if it is not trivial. Returns 0 if a taxon is unknown */
+static int tree_topology_recur(Node *current, Node *orig, fingerprint_keys *keys, map_t taxmap, fingerprint_t *fp, 
+			       int *card, int *has_taxon0, fingerprint_t *out){
+  int i, n = current->nneigh, child_card, child_has0, *id;
+  int curr_to_orig = dir_a_to_b(current, orig);
+  fingerprint_t child, canonical;
+
+  fp->lo = fp->hi = 0;
+  *card = 0;
+  *has_taxon0 = 0;
+  if(n == 1){
+    if(current->name == NULL || hashmap_get(taxmap, current->name, (any_t*)&id) != MAP_OK) return 0;
+    *fp = keys->keys[*id];
+    *card = 1;
+    *has_taxon0 = (*id == 0);
+    return 1;
+  }
+  for(i=1; i<n; i++){
+    if(!tree_topology_recur(current->neigh[(curr_to_orig+i)%n], current, keys, taxmap, &child, &child_card, &child_has0, out)) return 0;
+    fp->lo ^= child.lo;
+    fp->hi ^= child.hi;
+    *card += child_card;
+    *has_taxon0 |= child_has0;
+  }
+  if(*card >= 2 && *card <= keys->nb_taxa - 2){
+    canonical = canonical_fingerprint(keys, *fp, *has_taxon0);
+    out->lo += fingerprint_mix(canonical.lo);
+    out->hi += fingerprint_mix(canonical.hi);
+  }
+  return 1;
+}
+
+int tree_topology_fingerprint(Tree *tree, fingerprint_keys *keys, map_t taxmap, fingerprint_t *out){
+  int i, card, has_taxon0, n = tree->node0->nneigh;
+  fingerprint_t fp, canonical;
+  out->lo = out->hi = 0;
+  for(i=0; i<n; i++){
+    if(!tree_topology_recur(tree->node0->neigh[i], tree->node0, keys, taxmap, &fp, &card, &has_taxon0, out)) return 0;
+    /* the two edges of a root of degree 2 are the same split: it is counted once */
+    if(n == 2 && i == 0 && card >= 2 && card <= keys->nb_taxa - 2){
+      canonical = canonical_fingerprint(keys, fp, has_taxon0);
+      out->lo -= fingerprint_mix(canonical.lo);
+      out->hi -= fingerprint_mix(canonical.hi);
+    }
+  }
+  return 1;
+}
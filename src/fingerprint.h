@@ -0,0 +1,82 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _FINGERPRINT_H_
+#define _FINGERPRINT_H_
+
+#include <stdint.h>
+#include "hashtables_bfields.h"
+#include "tree.h"
+#include "hashmap.h"
+
+/* 
+   128 bits fingerprints of taxon sets (Zobrist hashing): each taxon id is given
+   a random 128 bits key, and the fingerprint of a set of taxa is the XOR of the keys
+   of its taxa. The fingerprint of a clade is thus the XOR of the fingerprints of its
+   sub-clades, which allows to compute the fingerprints of all the edges of a tree
+   in a single post-order traversal.
+
+   The canonical fingerprint of a bipartition is the fingerprint of its side that does NOT 
+   contain the taxon 0, so that a split and its complement have the same canonical fingerprint.
+   The keys only depend on the seed, so fingerprints computed for different trees sharing 
+   the same taxname lookup table can be compared.
+*/
+
+#define FINGERPRINT_SEED 0x5a17b0057e4ULL
+
+typedef struct fingerprint_t{
+  uint64_t lo;
+  uint64_t hi;
+} fingerprint_t;
+
+typedef struct fingerprint_keys{
+  int nb_taxa;
+  fingerprint_t *keys; /* one key per taxon id */
+  fingerprint_t all;   /* fingerprint of the whole taxon set */
+} fingerprint_keys;
+
+// Allocates the keys of nb_taxa taxa, deterministically from the seed
+fingerprint_keys* new_fingerprint_keys(int nb_taxa, uint64_t seed);
+void free_fingerprint_keys(fingerprint_keys *keys);
+
+// Fingerprint of the taxon set stored in the given bitset (not canonical)
+fingerprint_t fingerprint_id_hashtable(fingerprint_keys *keys, id_hash_table_t *h);
+// Canonical fingerprint of a bipartition, given the fingerprint of one side
+// and whether this side contains the taxon 0
+fingerprint_t canonical_fingerprint(fingerprint_keys *keys, fingerprint_t fp, int has_taxon0);
+// Computes the canonical fingerprints of all the edges of the tree, in a post-order traversal.
+// out must have room for tree->nb_edges fingerprints, and is indexed by edge id
+void tree_edge_fingerprints(Tree *tree, fingerprint_keys *keys, fingerprint_t *out);
+
+// Order independent fingerprint of the unrooted topology of a tree (the sum of a hash of the canonical 
+// fingerprints of its non trivial splits): two trees have the same fingerprint iff they have the same splits, 
+// whatever their rooting and the order of the children. The tree only needs to be parsed (parse_nh_string, 
+// no hashtables): its leaves are identified by name in taxmap (build_taxid_hashmap). 
+// Returns 0 if a leaf is not in taxmap, 1 otherwise
+int tree_topology_fingerprint(Tree *tree, fingerprint_keys *keys, map_t taxmap, fingerprint_t *out);
+
+#define fingerprint_equals(a,b) ((a).lo == (b).lo && (a).hi == (b).hi)
+
+#endif
@@ -133,13 +133,17 @@ void complement_id_hashtable(id_hash_table_t *destination, const id_hash_table_t
 }
 
 unsigned int bitCount (unsigned long value) {
-    unsigned int count = 0;
-    while (value) {           // until all bits are zero
-        if (value & 0x1)     // check LSB
-            count++;
-        value >>= 1;              // shift bits, deleting LSB
-    }
-    return count;
+    return __builtin_popcountl(value);
+}
+
+int first_id(id_hash_table_t *hashtable) {
+	/* returns the smallest taxon id stored in the hashtable, or -1 if it is empty.
+	   On the terminal edges, this is the id of the taxon at the leaf. */
+	int chunk;
+	for (chunk = 0; chunk < nbchunks_bitarray; chunk++) {
+		if (hashtable->bitarray[chunk]) return chunk * chunksize + __builtin_ctzl(hashtable->bitarray[chunk]);
+	}
+	return -1;
 }
 
 void update_id_hashtable(id_hash_table_t *source, id_hash_table_t *destination) {
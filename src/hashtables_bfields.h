@@ -74,6 +74,7 @@ void clear_id_hashtable(id_hash_table_t *hashtable);
 void fill_id_hashtable(id_hash_table_t *hashtable, int nb_taxa);
 void complement_id_hashtable(id_hash_table_t *destination, const id_hash_table_t *source, int nb_taxa);
 unsigned int bitCount (unsigned long value);
+int first_id(id_hash_table_t *hashtable);
 void update_id_hashtable(id_hash_table_t *source, id_hash_table_t *destination);
 int equal_id_hashtables(id_hash_table_t *tbl1, id_hash_table_t *tbl2);
 int complement_id_hashtables(id_hash_table_t *tbl1, id_hash_table_t *tbl2,int nb_taxa);
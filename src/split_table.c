@@ -0,0 +1,188 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "split_table.h"
+
+#define SPLIT_SHARD_INIT_CAPACITY 64
+#define SPLIT_SHARD_LOADFACTOR 0.75
+
+split_table* new_split_table(int nb_taxa, int nb_shards, int keep_splits){
+  int i;
+  split_table *st = malloc(sizeof(split_table));
+  st->nb_taxa = nb_taxa;
+  st->nb_shards = 1;
+  while(st->nb_shards < nb_shards) st->nb_shards <<= 1;
+  st->nb_trees = 0;
+  st->keep_splits = keep_splits;
+  st->keys = new_fingerprint_keys(nb_taxa, FINGERPRINT_SEED);
+  st->shards = malloc(st->nb_shards*sizeof(split_shard));
+  for(i=0; i<st->nb_shards; i++){
+    st->shards[i].capacity = SPLIT_SHARD_INIT_CAPACITY;
+    st->shards[i].total = 0;
+    st->shards[i].buckets = calloc(SPLIT_SHARD_INIT_CAPACITY, sizeof(split_entry*));
+    omp_init_lock(&(st->shards[i].lock));
+  }
+  return st;
+}
+
+void free_split_table(split_table *st){
+  int i, j;
+  split_entry *e, *next;
+  for(i=0; i<st->nb_shards; i++){
+    for(j=0; j<st->shards[i].capacity; j++){
+      for(e = st->shards[i].buckets[j]; e != NULL; e = next){
+	next = e->next;
+	if(e->split != NULL) free_id_hashtable(e->split);
+	free(e);
+      }
+    }
+    free(st->shards[i].buckets);
+    omp_destroy_lock(&(st->shards[i].lock));
+  }
+  free(st->shards);
+  free_fingerprint_keys(st->keys);
+  free(st);
+}
+
+static inline split_shard* split_table_shard(split_table *st, fingerprint_t fp){
+  return &(st->shards[fp.hi & (st->nb_shards-1)]);
+}
+
+/* doubles the number of buckets of the shard, the caller must hold its lock */
+static void split_shard_rehash(split_shard *sh){
+  int j, newcapacity = sh->capacity * 2;
+  split_entry **newbuckets = calloc(newcapacity, sizeof(split_entry*));
+  split_entry *e, *next;
+  for(j=0; j<sh->capacity; j++){
+    for(e = sh->buckets[j]; e != NULL; e = next){
+      next = e->next;
+      e->next = newbuckets[e->fp.lo & (newcapacity-1)];
+      newbuckets[e->fp.lo & (newcapacity-1)] = e;
+    }
+  }
+  free(sh->buckets);
+  sh->buckets = newbuckets;
+  sh->capacity = newcapacity;
+}
+
+/* canonical side of the split of the edge: the side that does not contain taxon 0 */
+static id_hash_table_t* canonical_split(Edge *e, int nb_taxa){
+  int i;
+  id_hash_table_t *h;
+  if(!lookup_id(e->hashtbl[1], 0)){
+    h = create_id_hash_table(nb_taxa);
+    for(i=0; i<nbchunks_bitarray; i++) h->bitarray[i] = e->hashtbl[1]->bitarray[i];
+    h->num_items = e->hashtbl[1]->num_items;
+  }else{
+    h = complement_id_hashtbl(e->hashtbl[1], nb_taxa);
+  }
+  return h;
+}
+
+static void split_table_add_split(split_table *st, fingerprint_t fp, Edge *e, int tree_index){
+  split_shard *sh = split_table_shard(st, fp);
+  split_entry *entry;
+  int bucket;
+
+  omp_set_lock(&(sh->lock));
+  bucket = fp.lo & (sh->capacity-1);
+  for(entry = sh->buckets[bucket]; entry != NULL; entry = entry->next){
+    if(fingerprint_equals(entry->fp, fp)) break;
+  }
+  if(entry == NULL){
+    entry = malloc(sizeof(split_entry));
+    entry->fp = fp;
+    entry->count = 0;
+    entry->brlen_sum = 0;
+    entry->last_tree = -1;
+    entry->nb_items = lookup_id(e->hashtbl[1], 0) ? st->nb_taxa - e->hashtbl[1]->num_items : e->hashtbl[1]->num_items;
+    entry->split = st->keep_splits ? canonical_split(e, st->nb_taxa) : NULL;
+    entry->next = sh->buckets[bucket];
+    sh->buckets[bucket] = entry;
+    sh->total++;
+    if(sh->total > SPLIT_SHARD_LOADFACTOR * sh->capacity) split_shard_rehash(sh);
+  }
+  /* the two edges around the root of a rooted tree define the same split: counted once, 
+     with the sum of their lengths */
+  if(entry->last_tree != tree_index){
+    entry->count++;
+    entry->last_tree = tree_index;
+  }
+  entry->brlen_sum += e->brlen;
+  omp_unset_lock(&(sh->lock));
+}
+
+void split_table_add_tree(split_table *st, Tree *tree, int tree_index){
+  int i;
+  fingerprint_t *fps = malloc(tree->nb_edges*sizeof(fingerprint_t));
+  tree_edge_fingerprints(tree, st->keys, fps);
+  for(i=0; i<tree->nb_edges; i++){
+    split_table_add_split(st, fps[i], tree->a_edges[i], tree_index);
+  }
+  free(fps);
+  #pragma omp atomic update
+  st->nb_trees++;
+}
+
+split_entry* split_table_get(split_table *st, fingerprint_t fp){
+  /* no lock: the table is only queried once all the trees have been inserted */
+  split_shard *sh = split_table_shard(st, fp);
+  split_entry *entry;
+  for(entry = sh->buckets[fp.lo & (sh->capacity-1)]; entry != NULL; entry = entry->next){
+    if(fingerprint_equals(entry->fp, fp)) return entry;
+  }
+  return NULL;
+}
+
+int split_table_count(split_table *st, fingerprint_t fp){
+  split_entry *entry = split_table_get(st, fp);
+  return (entry == NULL ? 0 : entry->count);
+}
+
+void split_table_tree_counts(split_table *st, Tree *tree, int *counts){
+  int i;
+  fingerprint_t *fps = malloc(tree->nb_edges*sizeof(fingerprint_t));
+  tree_edge_fingerprints(tree, st->keys, fps);
+  for(i=0; i<tree->nb_edges; i++){
+    counts[i] = split_table_count(st, fps[i]);
+  }
+  free(fps);
+}
+
+split_entry** split_table_entries(split_table *st, int *nb_entries){
+  int i, j, k = 0;
+  split_entry *e, **entries;
+  *nb_entries = 0;
+  for(i=0; i<st->nb_shards; i++) *nb_entries += st->shards[i].total;
+  entries = malloc((*nb_entries)*sizeof(split_entry*));
+  for(i=0; i<st->nb_shards; i++){
+    for(j=0; j<st->shards[i].capacity; j++){
+      for(e = st->shards[i].buckets[j]; e != NULL; e = e->next){
+	entries[k++] = e;
+      }
+    }
+  }
+  return entries;
+}
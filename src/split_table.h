@@ -0,0 +1,86 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _SPLIT_TABLE_H_
+#define _SPLIT_TABLE_H_
+
+#include <omp.h>
+#include "fingerprint.h"
+#include "tree.h"
+
+/* 
+   Global table counting, for each bipartition, the number of trees in which it is present.
+   The splits are identified by their canonical 128 bits fingerprint (see fingerprint.h).
+   The table is split into shards, each protected by its own lock, so that several threads can 
+   insert the splits of their trees at the same time: the shard of a split is given by the high 
+   bits of its fingerprint, and its bucket inside the shard by the low bits.
+   
+   Once all the bootstrap trees have been inserted, the support of any reference split is one lookup,
+   and the table can be queried for several reference trees, or enumerated to build consensus trees.
+*/
+
+typedef struct split_entry{
+  fingerprint_t fp;
+  int count;             /* number of trees containing the split */
+  int last_tree;         /* index of the last tree that incremented the count: a split is counted once per tree */
+  int nb_items;          /* number of taxa on the canonical side (the side without taxon 0) */
+  double brlen_sum;      /* sum of the lengths of the branch over the trees containing the split */
+  id_hash_table_t *split; /* canonical side of the split, only if the table keeps the splits, NULL otherwise */
+  struct split_entry *next;
+} split_entry;
+
+typedef struct split_shard{
+  int capacity;          /* number of buckets */
+  int total;             /* number of entries */
+  split_entry **buckets;
+  omp_lock_t lock;
+} split_shard;
+
+typedef struct split_table{
+  int nb_taxa;
+  int nb_shards;         /* power of 2 */
+  int nb_trees;          /* number of trees inserted so far */
+  int keep_splits;       /* if true, the entries store a copy of the canonical bitset of their split */
+  fingerprint_keys *keys;
+  split_shard *shards;
+} split_table;
+
+// Allocates a new split table for trees of nb_taxa taxa.
+// nb_shards is rounded up to a power of 2. 
+split_table* new_split_table(int nb_taxa, int nb_shards, int keep_splits);
+void free_split_table(split_table *st);
+// Inserts all the splits of the tree, tree_index must be unique for each tree (e.g. its index in the input file)
+// Thread safe: may be called concurrently for different trees
+void split_table_add_tree(split_table *st, Tree *tree, int tree_index);
+// Entry of the split of the given canonical fingerprint, NULL if absent
+split_entry* split_table_get(split_table *st, fingerprint_t fp);
+// Number of trees containing the split of the given canonical fingerprint (0 if absent)
+int split_table_count(split_table *st, fingerprint_t fp);
+// Fills counts (indexed by edge id) with the number of trees containing each edge of the tree
+void split_table_tree_counts(split_table *st, Tree *tree, int *counts);
+// Returns an array of all the entries of the table (to be freed by the caller, not the entries)
+split_entry** split_table_entries(split_table *st, int *nb_entries);
+
+#endif
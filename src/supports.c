@@ -0,0 +1,775 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "supports.h"
+#include "io.h"
+#include "bitset_index.h"
+#include "transfer.h"
+#include "accumulator.h"
+
+#include <string.h>
+#include <omp.h> /* OpenMP */
+#include <math.h>
+
+/* 
+   FBP counts of each reference tree summed by each thread apart, and their rows: the row of the thread t 
+   for the reference r at thread*nb_refs+r
+*/
+static thread_accumulator** new_found_accumulators(Tree **ref_trees, int nb_refs, int64_t ***rows){
+  int r, t, nb_threads = omp_get_max_threads();
+  thread_accumulator **acc = (thread_accumulator**) malloc(nb_refs * sizeof(thread_accumulator*));
+  *rows = (int64_t**) malloc(((long)nb_threads) * nb_refs * sizeof(int64_t*));
+  for(r=0; r<nb_refs; r++){
+    acc[r] = new_thread_accumulator(nb_threads, ref_trees[r]->nb_edges);
+    for(t=0; t<nb_threads; t++) (*rows)[t*nb_refs+r] = thread_accumulator_row(acc[r], t);
+  }
+  return acc;
+}
+
+/* Sums the FBP counts of the threads into nb_found[r] (ref_trees[r]->nb_edges ints), and frees the accumulators */
+static void reduce_found_accumulators(thread_accumulator **acc, int64_t **rows, Tree **ref_trees, int nb_refs, int **nb_found){
+  int r, i;
+  int64_t *found_sum;
+  for(r=0; r<nb_refs; r++){
+    found_sum = thread_accumulator_reduce(acc[r]);
+    for(i=0; i< ref_trees[r]->nb_edges; i++) nb_found[r][i] = found_sum[i];
+    free_thread_accumulator(acc[r]);
+  }
+  free(acc);
+  free(rows);
+}
+
+void fbp(Tree **ref_trees, int nb_refs, char **alt_tree_strings,char** taxname_lookup_table, int num_trees, int quiet, int dedup, split_table *st){
+  Tree *alt_tree;
+  int i_tree,r;
+  int n = ref_trees[0]->nb_taxa;
+  int **nb_found = (int**) malloc(nb_refs * sizeof(int*));
+  /* number of bootstrap trees with the topology of each tree, 0 if it is not the first one 
+     (not with a split table: the consensus needs the branch lengths of all the trees) */
+  int *topology = NULL, *multiplicity = NULL;
+  /* parsed trees of the first tree of each topology */
+  Tree **parsed = NULL;
+  /* nb_found of each thread, for each reference */
+  int64_t **found_rows;
+  thread_accumulator **found_acc = new_found_accumulators(ref_trees, nb_refs, &found_rows);
+
+  for(r=0; r<nb_refs; r++){
+    nb_found[r] = (int*) calloc(ref_trees[r]->nb_edges, sizeof(int));
+  }
+  if(dedup && st == NULL){
+    parsed = (Tree**) malloc(num_trees * sizeof(Tree*));
+    topology = bootstrap_topologies(alt_tree_strings, taxname_lookup_table, n, num_trees, quiet, parsed);
+    multiplicity = topology_multiplicities(topology, num_trees);
+  }
+ 
+#pragma omp parallel for private(alt_tree) shared(found_rows, st, ref_trees, alt_tree_strings, taxname_lookup_table, quiet, num_trees, multiplicity, parsed) schedule(dynamic)
+  for(i_tree=0; i_tree< num_trees; i_tree++){
+    int64_t **found = found_rows + omp_get_thread_num() * nb_refs;
+    if(multiplicity != NULL && multiplicity[i_tree] == 0) continue;
+    if(!quiet) fprintf(stderr,"New bootstrap tree : %d\n",i_tree);
+    if(parsed != NULL && parsed[i_tree] != NULL) alt_tree = complete_parsed_tree(parsed[i_tree], &taxname_lookup_table);
+    else alt_tree = complete_parse_nh(alt_tree_strings[i_tree], &taxname_lookup_table);
+    
+    if (alt_tree == NULL) {
+      fprintf(stderr,"Not a correct NH tree (%d). Skipping.\n%s\n",i_tree,alt_tree_strings[i_tree]);
+      continue; /* some files maybe not containing trees */
+    }
+    if (alt_tree->nb_taxa != n) {
+      fprintf(stderr,"This tree doesn't have the same number of taxa as the reference tree. Skipping.\n");
+      continue; /* some files maybe not containing trees */
+    }
+
+    /****************************************************/
+    /*     comparison of the bipartitions, FBP method   */
+    /****************************************************/
+    fbp_count_tree(ref_trees, nb_refs, alt_tree, found, (multiplicity != NULL ? multiplicity[i_tree] : 1));
+    if(st != NULL) split_table_add_tree(st, alt_tree, i_tree);
+    free_tree(alt_tree);
+  }
+
+  #pragma omp barrier
+
+  reduce_found_accumulators(found_acc, found_rows, ref_trees, nb_refs, nb_found);
+  for(r=0; r<nb_refs; r++){
+    set_fbp_supports(ref_trees[r], nb_found[r], num_trees);
+    free(nb_found[r]);
+  }
+  free(nb_found);
+  free(parsed);
+  free(topology);
+  free(multiplicity);
+}
+
+/* 
+   Same result as fbp, but instead of building one hashmap per bootstrap tree and probing it with
+   all the reference splits, all the threads insert the splits of their bootstrap trees into one 
+   shared split table. The support of each reference split is then one lookup in this table.
+*/
+void fbp_table(Tree **ref_trees, int nb_refs, char **alt_tree_strings,char** taxname_lookup_table, int num_trees, int quiet, split_table *st){
+  Tree *alt_tree;
+  int i_tree, r;
+  int *nb_found;
+
+#pragma omp parallel for private(alt_tree) shared(st, ref_trees, alt_tree_strings, taxname_lookup_table, quiet, num_trees) schedule(dynamic)
+  for(i_tree=0; i_tree< num_trees; i_tree++){
+    if(!quiet) fprintf(stderr,"New bootstrap tree : %d\n",i_tree);
+    alt_tree = complete_parse_nh(alt_tree_strings[i_tree], &taxname_lookup_table);
+    
+    if (alt_tree == NULL) {
+      fprintf(stderr,"Not a correct NH tree (%d). Skipping.\n%s\n",i_tree,alt_tree_strings[i_tree]);
+      continue; /* some files maybe not containing trees */
+    }
+    if (alt_tree->nb_taxa != ref_trees[0]->nb_taxa) {
+      fprintf(stderr,"This tree doesn't have the same number of taxa as the reference tree. Skipping.\n");
+      continue; /* some files maybe not containing trees */
+    }
+    split_table_add_tree(st, alt_tree, i_tree);
+    free_tree(alt_tree);
+  }
+
+  #pragma omp barrier
+
+  /* the table is built once for all the reference trees */
+  for(r=0; r<nb_refs; r++){
+    nb_found = malloc(ref_trees[r]->nb_edges * sizeof(int));
+    split_table_tree_counts(st, ref_trees[r], nb_found);
+    set_fbp_supports(ref_trees[r], nb_found, num_trees);
+    free(nb_found);
+  }
+}
+
+/* 
+   Adds weight to found[r][j] for each branch j of the reference tree r that is in the bootstrap tree:
+   the hashmap of the bootstrap splits is built once, and probed with the splits of each reference tree
+*/
+void fbp_count_tree(Tree **ref_trees, int nb_refs, Tree *alt_tree, int64_t **found, int weight){
+  int j, r;
+  // We initialize the reference edge hashmap
+  bitset_hashmap *hm = new_bitset_hashmap(alt_tree->nb_edges*2, 0.75);
+  for (j = 0; j <  alt_tree->nb_edges; j++) {
+    bitset_hashmap_putvalue(hm,alt_tree->a_edges[j]->hashtbl[1],alt_tree->nb_taxa,j);
+  }
+  for (r = 0; r < nb_refs; r++) {
+    for (j = 0; j <  ref_trees[r]->nb_edges; j++) {
+      // We query the hashmap to see if the edge is present, and then get its reference index
+      int refindex = bitset_hashmap_value(hm, ref_trees[r]->a_edges[j]->hashtbl[1], ref_trees[r]->nb_taxa);
+      if (refindex>-1){
+	found[r][j] += weight;
+      }
+    }
+  }
+  free_bitset_hashmap(hm);
+}
+
+/* Writes the mean transfer distance of each internal branch of the reference tree as its name, in the form id|avgdist|depth */
+void set_raw_names(Tree *ref_tree, double *mean_dist, int num_trees){
+  int i;
+  if(num_trees != 0) {
+    for (i = 0; i <  ref_tree->nb_edges; i++) {
+      if(ref_tree->a_edges[i]->right->nneigh == 1) { continue; }
+      if(ref_tree->a_edges[i]->right->name) free(ref_tree->a_edges[i]->right->name); /* clear name if existing */
+      ref_tree->a_edges[i]->right->name = (char*) malloc(64 * sizeof(char));
+      sprintf(ref_tree->a_edges[i]->right->name, "%d|%.6f|%d", ref_tree->a_edges[i]->id, mean_dist[i], ref_tree->a_edges[i]->topo_depth);
+    }
+  }
+}
+
+/* Writes the proportion of trees containing each internal branch of the reference tree as its support */
+void set_fbp_supports(Tree *ref_tree, int *nb_found, int num_trees){
+  int i;
+  double support;
+  if(num_trees != 0) {
+    for (i = 0; i <  ref_tree->nb_edges; i++) {
+      if(ref_tree->a_edges[i]->right->nneigh == 1) { continue; }
+      /* the bootstrap value for a branch is inscribed as the name of its descendant (always right side of the edge, by convention) */
+      if(ref_tree->a_edges[i]->right->name) free(ref_tree->a_edges[i]->right->name); /* clear name if existing */
+      ref_tree->a_edges[i]->right->name = (char*) malloc(16 * sizeof(char));
+      support   = (double) nb_found[i] * 1.0 / num_trees;
+      sprintf(ref_tree->a_edges[i]->right->name, "%.6f", support);
+      ref_tree->a_edges[i]->branch_support = support;
+    }
+  }
+}
+
+/* 
+   Table of the -c counts in the stat file: one line per internal branch, one column per taxon. The counts
+   are sorted by branch and taxon (key i*n+j): the lines are written as the list is walked
+*/
+static void write_dense_counts(FILE *out, Tree *ref_tree, char **taxname_lookup_table, sparse_entry *counts, long nb_counts, int num_trees){
+  int i, j, n = ref_tree->nb_taxa;
+  long c = 0;
+  fprintf(out,"Edge\tSupport");
+  for(i=0; i<n;i++){
+    fprintf(out,"\t%s", taxname_lookup_table[i]);
+  }
+  fprintf(out,"\n");
+  for(i=0; i<ref_tree->nb_edges;i++){
+    if(ref_tree->a_edges[i]->right->nneigh == 1) { continue; }
+    fprintf(out,"%d\t%s", i,ref_tree->a_edges[i]->right->name);
+    while(c < nb_counts && counts[c].key < ((int64_t)i)*n) c++;
+    for(j=0;j<n;j++){
+      if(c < nb_counts && counts[c].key == ((int64_t)i)*n + j) fprintf(out,"\t%f",counts[c++].value*1.0/num_trees);
+      else fprintf(out,"\t%f",0.0);
+    }
+    fprintf(out,"\n");
+  }
+}
+
+/* 
+   The -c counts as (branch, taxon, value) triples, for the non zero values only (--count-file). The binary 
+   format is COUNT_MAGIC, then the number of taxa and of bootstrap trees (int32) and the number of triples 
+   (int64), then the taxon names (int32 length, and the characters), then for each triple the branch and the 
+   taxon (int32) and the number of trees (int64), in the byte order of the machine
+*/
+static void write_sparse_counts(FILE *out, int binary, Tree *ref_tree, char **taxname_lookup_table, sparse_entry *counts, long nb_counts, int num_trees){
+  int n = ref_tree->nb_taxa, j;
+  int32_t ids[2];
+  int64_t nb = nb_counts;
+  long c;
+  if(binary){
+    ids[0] = n;
+    ids[1] = num_trees;
+    fwrite(COUNT_MAGIC, 1, 4, out);
+    fwrite(ids, sizeof(int32_t), 2, out);
+    fwrite(&nb, sizeof(int64_t), 1, out);
+    for(j=0; j<n; j++){
+      ids[0] = strlen(taxname_lookup_table[j]);
+      fwrite(ids, sizeof(int32_t), 1, out);
+      fwrite(taxname_lookup_table[j], 1, ids[0], out);
+    }
+  } else {
+    fprintf(out,"Edge\tTaxon\tValue\n");
+  }
+  for(c=0; c<nb_counts; c++){
+    ids[0] = counts[c].key / n;
+    ids[1] = counts[c].key % n;
+    if(binary){
+      fwrite(ids, sizeof(int32_t), 2, out);
+      fwrite(&(counts[c].value), sizeof(int64_t), 1, out);
+    } else {
+      fprintf(out,"%d\t%s\t%f\n", ids[0], taxname_lookup_table[ids[1]], counts[c].value*1.0/num_trees);
+    }
+  }
+}
+
+/* bucket of a transfer distance in the histograms: 0 for 0, b for a normalized distance in ](b-1)/HIST_BUCKETS, b/HIST_BUCKETS] */
+static int hist_bucket(int dist, int topo_depth){
+  int b;
+  if(dist == 0 || topo_depth < 2) return 0;
+  b = (HIST_BUCKETS * dist + topo_depth - 2) / (topo_depth - 1);
+  return (b > HIST_BUCKETS ? HIST_BUCKETS : b);
+}
+
+/* 
+   Histograms of the internal branches, one line per branch: id, depth, and the number of bootstrap trees in 
+   each bucket. The binary format is HIST_MAGIC, then the number of branches and of buckets (int32), then for 
+   each branch its id, its depth (int32) and its counts (int64), in the byte order of the machine.
+*/
+static void write_histograms(FILE *out, int binary, Tree *ref_tree, int64_t *hist){
+  int i, b, nb = 0, buckets = HIST_BUCKETS+1;
+  int32_t header[2];
+  for(i=0; i<ref_tree->nb_edges; i++) nb += (ref_tree->a_edges[i]->right->nneigh > 1);
+  if(binary){
+    header[0] = nb;
+    header[1] = buckets;
+    fwrite(HIST_MAGIC, 1, 4, out);
+    fwrite(header, sizeof(int32_t), 2, out);
+  } else {
+    fprintf(out,"EdgeId\tDepth\t0");
+    for(b=1; b<buckets; b++) fprintf(out,"\t%.1f-%.1f", (b-1) * 1.0 / HIST_BUCKETS, b * 1.0 / HIST_BUCKETS);
+    fprintf(out,"\n");
+  }
+  for(i=0; i<ref_tree->nb_edges; i++){
+    if(ref_tree->a_edges[i]->right->nneigh == 1) continue;
+    if(binary){
+      header[0] = i;
+      header[1] = ref_tree->a_edges[i]->topo_depth;
+      fwrite(header, sizeof(int32_t), 2, out);
+      fwrite(hist + ((long)i)*buckets, sizeof(int64_t), buckets, out);
+    } else {
+      fprintf(out,"%d\t%d", i, ref_tree->a_edges[i]->topo_depth);
+      for(b=0; b<buckets; b++) fprintf(out,"\t%ld", (long)hist[((long)i)*buckets + b]);
+      fprintf(out,"\n");
+    }
+  }
+}
+
+/* one reference tree of tbe(): its index, the work arrays of each thread and the sums of the threads */
+typedef struct tbe_reference {
+  Tree *tree;
+  ref_index *ref;
+  int kernel;
+  column_cache *cache;                /* subtrees common to several bootstrap trees, for the column kernel */
+  tbe_workspace **workspaces;         /* batch workspaces per thread, allocated by the thread at its first batch */
+  thread_accumulator *tindex_acc;     /* tIndex of each taxon in fixed point, then the number of trees without close branch */
+  sparse_accumulator *per_branch_acc; /* -c counts, at i*n+j */
+  thread_accumulator *dist_acc;       /* sum and sum of squares of the min distance of each branch, at 2i and 2i+1 */
+  thread_accumulator *extreme_acc;    /* min and -max of the min distance of each branch, at 2i and 2i+1 */
+  thread_accumulator *hist_acc;       /* histogram of each branch, at i*(HIST_BUCKETS+1) */
+} tbe_reference;
+
+/* Adds the transfer distances of the bootstrap tree alt_tree, computed in ws, to the sums of the thread for the reference r */
+static void tbe_add_tree(tbe_reference *r, int thread, tbe_workspace *ws, Tree *alt_tree, int weight, double dist_cutoff, int mindepth){
+  int i, j, k;
+  int m = r->tree->nb_edges;
+  int n = r->tree->nb_taxa;
+  ref_index *ref = r->ref;
+  short unsigned* min_dist = ws->min_dist;
+  short unsigned* min_dist_edge = ws->min_dist_edge; /* array of edge ids corresponding to min Hamming distances */
+  int *moved_species = ws->moved_species; /* array of number of branches in which each taxon moves, in this tree */
+  int *sm = ws->species; /* species to move around one branch */
+  int64_t *tindex = (r->tindex_acc != NULL ? thread_accumulator_row(r->tindex_acc, thread) : NULL);
+  int64_t *dist_stat = thread_accumulator_row(r->dist_acc, thread);
+  int64_t *extreme = thread_accumulator_row(r->extreme_acc, thread);
+  int64_t *hist = (r->hist_acc != NULL ? thread_accumulator_row(r->hist_acc, thread) : NULL);
+
+  for (i = 0; i < m; i++) {
+    dist_stat[2*i] += ((int64_t)weight) * min_dist[i];
+    dist_stat[2*i+1] += ((int64_t)weight) * min_dist[i] * min_dist[i];
+    if(min_dist[i] < extreme[2*i]) extreme[2*i] = min_dist[i];
+    if(-min_dist[i] < extreme[2*i+1]) extreme[2*i+1] = -min_dist[i];
+  }
+  if(hist != NULL){
+    for(k=0;k<ref->nb_internal;k++){
+      i = ref->internal[k];
+      hist[((long)i)*(HIST_BUCKETS+1) + hist_bucket(min_dist[i], ref->topo_depth[i])] += weight;
+    }
+  }
+
+  /* Looking at number of times each taxon moves around low distance branches: the transfer index, 
+     only printed in the stat file. The taxa moved around the other branches are only needed with -c */
+  if(tindex != NULL || r->per_branch_acc != NULL){
+    memset(moved_species, 0, n*sizeof(int));
+    int nb_branches_close=0, close;
+    for(k=0;k<ref->nb_internal;k++){
+      i = ref->internal[k];
+      close = (((double)min_dist[i]) * 1.0 / ref->denom[i] <= dist_cutoff && ref->topo_depth[i] >= mindepth);
+      nb_branches_close += close;
+      if(!close && r->per_branch_acc == NULL) continue;
+      species_to_move(r->tree->a_edges[i], alt_tree->a_edges[min_dist_edge[i]], min_dist[i], n, sm);
+      for(j=0;j<min_dist[i];j++){
+	if(close){
+	  moved_species[sm[j]]++;
+	}
+	if(r->per_branch_acc != NULL){
+	  sparse_accumulator_add(r->per_branch_acc, thread, ((int64_t)i)*n + sm[j], weight);
+	}
+      }
+    }
+    if(tindex == NULL){
+      /* -c only */
+    } else if(nb_branches_close == 0){
+      tindex[n] += weight;
+    } else {
+      for (i=0; i < n; i++){
+	tindex[i] += weight * accumulator_fixed(moved_species[i], nb_branches_close);
+      }
+    }
+  }
+}
+
+/* 
+   Writes the statistics of the reference r over the bootstrap trees (stat, histogram and count files), 
+   and its supports as the names of its branches. Frees the sums of the threads.
+*/
+static void tbe_write_reference(tbe_reference *r, double *mean_dist, char **taxname_lookup_table, const tbe_options *opt, int num_trees){
+  Tree *ref_tree = r->tree;
+  int i;
+  int n = ref_tree->nb_taxa;
+  double *moved_species_counts = (double*) calloc(n,sizeof(double)); /* array of average branch rate in which each taxon moves */
+  int64_t nb_trees_close = num_trees; /* number of bootstrap trees with at least one close branch */
+
+  /* sums of the threads, in the same order whatever the number of threads */
+  if(r->tindex_acc != NULL){
+    int64_t *tindex_sum = thread_accumulator_reduce(r->tindex_acc);
+    for(i=0; i<n; i++){
+      moved_species_counts[i] = ((double)tindex_sum[i]) / ACCUMULATOR_ONE;
+    }
+    /* the rate of a tree without close branch is undefined (0/0): the tree is left out of the mean */
+    nb_trees_close -= tindex_sum[n];
+    free_thread_accumulator(r->tindex_acc);
+  }
+
+  int64_t *dist_sum = thread_accumulator_reduce(r->dist_acc);
+  int64_t *dist_extreme = thread_accumulator_reduce_min(r->extreme_acc);
+  int card;
+  double bootstrap_val, avg_dist, sd_dist, ci_dist;
+		
+  if(num_trees != 0) {
+    if(opt->stat_file != NULL)
+      fprintf(opt->stat_file,"EdgeId\tDepth\tMeanMinDist\tSdMinDist\tMinMinDist\tMaxMinDist\tCI95Low\tCI95High\n");
+
+    /* OUTPUT FINAL STATISTICS and UPDATE REF TREE WITH BOOTSTRAP VALUES */
+    for (i = 0; i <  ref_tree->nb_edges; i++) {
+      if(ref_tree->a_edges[i]->right->nneigh == 1) { continue; }
+
+      /* the bootstrap value for a branch is inscribed as the name of its descendant (always right side of the edge, by convention) */
+      if(ref_tree->a_edges[i]->right->name) free(ref_tree->a_edges[i]->right->name); /* clear name if existing */
+      ref_tree->a_edges[i]->right->name = (char*) malloc(16 * sizeof(char));
+      card = ref_tree->a_edges[i]->hashtbl[1]->num_items;
+      if (card > n/2) { card = n - card; }	  
+      avg_dist      = (double) dist_sum[2*i] * 1.0 / num_trees;
+      bootstrap_val = (double) 1.0 - avg_dist * 1.0 / (1.0 * ref_tree->a_edges[i]->topo_depth-1.0);
+
+      if(opt->stat_file != NULL){
+	/* sample standard deviation from the exact sums: N*S2 - S1*S1 is computed exactly in 128 bits (up to 
+	   (n*N)^2), so there is no cancellation before the single rounding of the division. Normal 95% 
+	   confidence interval of the mean, clamped at 0 as a distance is never negative */
+	sd_dist = 0.0;
+	if(num_trees > 1){
+	  __int128 spread = ((__int128)num_trees) * dist_sum[2*i+1] - ((__int128)dist_sum[2*i]) * dist_sum[2*i];
+	  sd_dist = sqrt((double)((long double)spread / ((long double)num_trees * (num_trees - 1))));
+	}
+	ci_dist = 1.96 * sd_dist / sqrt((double)num_trees);
+	if(dist_extreme[2*i] == INT64_MAX) dist_extreme[2*i] = dist_extreme[2*i+1] = 0; /* no tree analyzed */
+	fprintf(opt->stat_file,"%d\t%d\t%f\t%f\t%d\t%d\t%f\t%f\n", i, (ref_tree->a_edges[i]->topo_depth), avg_dist,
+		sd_dist, (int)dist_extreme[2*i], (int)(-dist_extreme[2*i+1]), (avg_dist > ci_dist ? avg_dist - ci_dist : 0.0), avg_dist + ci_dist);
+      }
+
+      sprintf(ref_tree->a_edges[i]->right->name, "%.6f", bootstrap_val);
+
+      ref_tree->a_edges[i]->branch_support = bootstrap_val;
+      
+      /* for the raw tree (set_raw_names) */
+      if(mean_dist != NULL) mean_dist[i] = avg_dist;
+    }
+
+    if(opt->stat_file != NULL){
+      fprintf(opt->stat_file,"Taxon\ttIndex\n");
+      for(i=0; i<n;i++){
+	if(nb_trees_close == 0) fprintf(opt->stat_file,"%s\tNA\n", taxname_lookup_table[i]);
+	else fprintf(opt->stat_file,"%s\t%f\n", taxname_lookup_table[i], moved_species_counts[i]*100.0 / ((double)nb_trees_close));
+      }
+    }
+  }
+
+  if(r->per_branch_acc != NULL){
+    sparse_entry *counts;
+    long nb_counts = sparse_accumulator_reduce(r->per_branch_acc, &counts);
+    free_sparse_accumulator(r->per_branch_acc);
+    if(opt->count_file != NULL) write_sparse_counts(opt->count_file, opt->count_binary, ref_tree, taxname_lookup_table, counts, nb_counts, num_trees);
+    else write_dense_counts(opt->stat_file, ref_tree, taxname_lookup_table, counts, nb_counts, num_trees);
+    free(counts);
+  }
+  
+  free_thread_accumulator(r->dist_acc);
+  free_thread_accumulator(r->extreme_acc);
+  if(r->hist_acc != NULL){
+    write_histograms(opt->hist_file, opt->hist_binary, ref_tree, thread_accumulator_reduce(r->hist_acc));
+    free_thread_accumulator(r->hist_acc);
+  }
+  free(moved_species_counts);
+}
+
+/* 
+   TBE supports of each of the nb_refs reference trees. Each bootstrap tree is parsed once and compared to all
+   the reference trees in turn, the outputs of the references following each other in the stat, histogram and 
+   count files. mean_dist[r] and nb_found[r], if not NULL, get the mean distance and the FBP count of each
+   branch of the reference r.
+*/
+void tbe(Tree **ref_trees, int nb_refs, double **mean_dist, int **nb_found, char **alt_tree_strings,char** taxname_lookup_table, int num_trees, const tbe_options *opt, split_table *st){
+  int i, r;
+  int n = ref_trees[0]->nb_taxa;
+  Tree *alt_tree;
+  int i_tree;
+  /** Max number of branches we can see in the bootstrap tree: If it has no multifurcation : binary tree--> ntax*2-2 (if rooted...) */
+  int max_branches_boot = n*2-2;
+  /* the trees are processed by batches of opt->batch trees. One workspace per tree of a batch, per thread and per 
+     reference tree, allocated by the thread itself at its first batch and reused for the next ones */
+  int nb_batches = (num_trees + opt->batch - 1) / opt->batch;
+  int i_batch;
+  int nb_workspaces = omp_get_max_threads() * opt->batch;
+  Tree **batch_trees = (Tree**) calloc(nb_workspaces, sizeof(Tree*));
+  int *batch_tree_ids = (int*) calloc(nb_workspaces, sizeof(int));
+  tbe_workspace *ws;
+  tbe_reference *refs = (tbe_reference*) calloc(nb_refs, sizeof(tbe_reference));
+  /* first bootstrap tree with the topology of each tree, and number of trees with the topology of each tree, 
+     0 if it is not the first one (not with a split table: the consensus needs the branch lengths of all the trees) */
+  int *topology = NULL, *multiplicity = NULL;
+  /* parsed trees of the first tree of each topology */
+  Tree **parsed = NULL;
+  if(opt->dedup && st == NULL){
+    parsed = (Tree**) malloc(num_trees * sizeof(Tree*));
+    topology = bootstrap_topologies(alt_tree_strings, taxname_lookup_table, n, num_trees, opt->quiet, parsed);
+    multiplicity = topology_multiplicities(topology, num_trees);
+  }
+
+  /* number of bootstrap trees actually analyzed */
+  int nb_analyzed = num_trees;
+  if(multiplicity != NULL){
+    for(i_tree=0, nb_analyzed=0; i_tree < num_trees; i_tree++) nb_analyzed += (multiplicity[i_tree] > 0);
+  }
+  /* reference side, computed once for all the bootstrap trees */
+  int min_internal = -1;
+  for(r=0; r<nb_refs; r++){
+    refs[r].tree = ref_trees[r];
+    refs[r].ref = new_ref_index(ref_trees[r]);
+    if(min_internal < 0 || refs[r].ref->nb_internal < min_internal) min_internal = refs[r].ref->nb_internal;
+  }
+  /* fewer trees than threads: the threads share the rows of each tree (column kernel) instead of the trees */
+  int intra = (omp_get_max_threads() > 1 && nb_analyzed < omp_get_max_threads() && opt->cache_mem <= 0 && opt->batch <= 1
+	       && (opt->kernel == TBE_KERNEL_AUTO || opt->kernel == TBE_KERNEL_COLUMNS)
+	       && min_internal >= omp_get_max_threads() * TBE_ROWS_MIN_PART);
+  if(intra && !opt->quiet) fprintf(stderr,"Fewer bootstrap trees than threads: each tree is shared by %d threads\n", omp_get_max_threads());
+  /* minimum depth of the branches considered for the transfer index */
+  int mindepth = (int)(ceil(1.0/opt->dist_cutoff + 1.0));
+
+  for(r=0; r<nb_refs; r++){
+    ref_index *ref = refs[r].ref;
+    int m = ref_trees[r]->nb_edges;
+    /* column kernel if asked, or if the I matrix of each thread would be too large */
+    refs[r].kernel = opt->kernel;
+    if(opt->cache_mem > 0 && (opt->kernel == TBE_KERNEL_AUTO || opt->kernel == TBE_KERNEL_COLUMNS)){
+      refs[r].kernel = TBE_KERNEL_COLUMNS;
+      /* the memory of the cache is shared by the reference trees */
+      refs[r].cache = new_column_cache(ref->nb_internal, (((size_t)opt->cache_mem) << 20) / nb_refs, 64*omp_get_max_threads());
+      if(refs[r].cache == NULL) fprintf(stderr,"The column cache cannot hold a single column in %d MB: no cache\n", opt->cache_mem);
+      else ref_index_add_fingerprints(ref);
+    } else if(opt->batch > 1 && (opt->kernel == TBE_KERNEL_AUTO || opt->kernel == TBE_KERNEL_COLUMNS)){
+      refs[r].kernel = TBE_KERNEL_BATCH;
+    } else if(intra){
+      refs[r].kernel = TBE_KERNEL_ROWS;
+    } else if(opt->kernel == TBE_KERNEL_AUTO){
+      refs[r].kernel = (((size_t)ref->nb_internal) * max_branches_boot * sizeof(short unsigned) > TBE_DENSE_MAX_BYTES ? TBE_KERNEL_COLUMNS : TBE_KERNEL_DENSE);
+    }
+    if(refs[r].kernel == TBE_KERNEL_POPCOUNT) ref_index_add_clades(ref);
+    else if(refs[r].kernel == TBE_KERNEL_FAST) ref_index_add_steps(ref);
+    else if(refs[r].kernel == TBE_KERNEL_SPARSE) ref_index_add_sparse(ref, n / TBE_SPARSE_DEPTH_RATIO);
+    else if(refs[r].kernel == TBE_KERNEL_CONTRACT) ref_index_add_fingerprints(ref);
+    else if(refs[r].kernel == TBE_KERNEL_ROWS) ref_index_add_parts(ref, omp_get_max_threads());
+    refs[r].workspaces = (tbe_workspace**) calloc(nb_workspaces, sizeof(tbe_workspace*));
+  
+    /* number of bootstrap trees from which each taxon j moves around the branch i, at key i*n+j: few taxa move 
+       around each branch, so only the non zero counts are kept, and the tIndex of each taxon in fixed point 
+       (with the number of trees without any close branch after the n taxa), summed by each thread apart */
+    refs[r].tindex_acc = (opt->stat_file != NULL ? new_thread_accumulator(omp_get_max_threads(), n+1) : NULL);
+    if((opt->stat_file != NULL && opt->count_per_branch) || opt->count_file != NULL){
+      refs[r].per_branch_acc = new_sparse_accumulator(omp_get_max_threads());
+    }
+    /* min distance of each branch over the trees, summed by each thread apart: sum and sum of squares at 2i and 2i+1 
+       (exact integers), and min and -max at 2i and 2i+1 */
+    refs[r].dist_acc = new_thread_accumulator(omp_get_max_threads(), 2*((long)m));
+    refs[r].extreme_acc = new_thread_accumulator(omp_get_max_threads(), 2*((long)m));
+    thread_accumulator_fill(refs[r].extreme_acc, INT64_MAX);
+    /* number of trees in each bucket of the histogram of each branch, at i*(HIST_BUCKETS+1) */
+    refs[r].hist_acc = (opt->hist_file != NULL ? new_thread_accumulator(omp_get_max_threads(), ((long)m)*(HIST_BUCKETS+1)) : NULL);
+  }
+  /* FBP counts of the same trees, if asked (-a tbe,fbp) */
+  int64_t **found_rows = NULL;
+  thread_accumulator **found_acc = (nb_found != NULL ? new_found_accumulators(ref_trees, nb_refs, &found_rows) : NULL);
+
+#pragma omp parallel for private(ws, r, i_tree, alt_tree) shared(st, refs, multiplicity, parsed, mindepth, batch_trees, batch_tree_ids, opt, ref_trees, alt_tree_strings, taxname_lookup_table, found_rows) schedule(dynamic) if(!intra)
+  for(i_batch=0; i_batch < nb_batches; i_batch++){
+    /* the slots of this thread */
+    int thread = omp_get_thread_num();
+    Tree **trees = batch_trees + thread * opt->batch;
+    int *tree_ids = batch_tree_ids + thread * opt->batch;
+    int nb = 0, t;
+
+    /* the trees of the batch are parsed once, for all the reference trees */
+    for(i_tree=i_batch*opt->batch; i_tree < num_trees && i_tree < (i_batch+1)*opt->batch; i_tree++){
+      if(multiplicity != NULL && multiplicity[i_tree] == 0) continue;
+      if(!opt->quiet) fprintf(stderr,"New bootstrap tree : %d\n",i_tree);
+      if(parsed != NULL && parsed[i_tree] != NULL) alt_tree = complete_parsed_tree(parsed[i_tree], &taxname_lookup_table);
+      else alt_tree = complete_parse_nh(alt_tree_strings[i_tree], &taxname_lookup_table);
+    
+      if (alt_tree == NULL) {
+	fprintf(stderr,"Not a correct NH tree (%d). Skipping.\n%s\n",i_tree,alt_tree_strings[i_tree]);
+	continue; /* some files maybe not containing trees */
+      }
+      if (alt_tree->nb_taxa != n) {
+	fprintf(stderr,"This tree doesn't have the same number of taxa as the reference tree. Skipping.\n");
+	continue; /* some files maybe not containing trees */
+      }
+      trees[nb] = alt_tree;
+      tree_ids[nb++] = i_tree;
+    }
+
+    for(r=0; r<nb_refs; r++){
+      tbe_workspace **thread_ws = refs[r].workspaces + thread * opt->batch;
+      for(t=0; t<nb; t++){
+	ws = thread_ws[t];
+	if(ws == NULL){
+	  ws = thread_ws[t] = new_tbe_workspace(n, ref_trees[r]->nb_edges, refs[r].ref->nb_internal, refs[r].kernel, opt->huge_pages);
+	  if(refs[r].cache != NULL) tbe_workspace_add_cache(ws, refs[r].cache);
+	  if(refs[r].kernel == TBE_KERNEL_ROWS) tbe_workspace_add_parts(ws, refs[r].ref, opt->huge_pages);
+	}
+	/****************************************************/
+	/* comparison of the bipartitions, Transfer method */
+	/****************************************************/		  
+	/* calculation of the I matrix (see Brehelin/Gascuel/Martin) or of the popcounts, the transfer distances are computed on the fly.
+	   The batch kernel only compiles the tree here, and computes the distances of all the trees of the batch at once */
+	if(refs[r].kernel == TBE_KERNEL_BATCH) tbe_batch_compile(trees[t], ws);
+	else min_transfer_distances(refs[r].ref, trees[t], ws);
+      }
+      if(refs[r].kernel == TBE_KERNEL_BATCH && nb > 0) min_transfer_distances_batch(refs[r].ref, thread_ws, nb);
+
+      for(t=0; t<nb; t++){
+	tbe_add_tree(&refs[r], thread, thread_ws[t], trees[t], (multiplicity != NULL ? multiplicity[tree_ids[t]] : 1), opt->dist_cutoff, mindepth);
+      }
+    }
+
+    for(t=0; t<nb; t++){
+      /* the FBP supports, on the tree already parsed */
+      if(found_rows != NULL) fbp_count_tree(ref_trees, nb_refs, trees[t], found_rows + thread * nb_refs, (multiplicity != NULL ? multiplicity[tree_ids[t]] : 1));
+      if(st != NULL) split_table_add_tree(st, trees[t], tree_ids[t]);
+      free_tree(trees[t]);
+    }
+  }
+
+  #pragma omp barrier
+
+  for(r=0; r<nb_refs; r++){
+    for(i=0; i<nb_workspaces; i++){
+      if(refs[r].workspaces[i] != NULL) free_tbe_workspace(refs[r].workspaces[i]);
+    }
+    free(refs[r].workspaces);
+    free_ref_index(refs[r].ref);
+    if(refs[r].cache != NULL){
+      long lookups, hits;
+      column_cache_stats(refs[r].cache, &lookups, &hits);
+      if(!opt->quiet) fprintf(stderr,"Column cache: %ld hits / %ld lookups (%.1f%%)\n", hits, lookups, (lookups > 0 ? 100.0 * hits / lookups : 0.0));
+      free_column_cache(refs[r].cache);
+    }
+    tbe_write_reference(&refs[r], (mean_dist != NULL ? mean_dist[r] : NULL), taxname_lookup_table, opt, num_trees);
+  }
+  if(found_acc != NULL) reduce_found_accumulators(found_acc, found_rows, ref_trees, nb_refs, nb_found);
+  free(refs);
+  free(batch_trees);
+  free(batch_tree_ids);
+  free(parsed);
+  free(topology);
+  free(multiplicity);
+}
+
+
+
+// Fills species with the ids of the species to move to go from one branch to the other
+// (the taxa on which the two bipartitions differ, in increasing order)
+// species must have room for nb_taxa ids, and the number of species should correspond to given dist
+// If not, exit with an error
+void species_to_move(Edge* re, Edge* be, int dist, int nb_taxa, int *species) {
+  int w, nbdiff=0, nbequ=0;
+  int nb_words = nb_taxa/chunksize + (nb_taxa%chunksize != 0 ? 1 : 0);
+  const unsigned long *a = re->hashtbl[1]->bitarray, *b = be->hashtbl[1]->bitarray;
+  /* bits of the last word beyond the last taxon */
+  unsigned long last_mask = (nb_taxa%chunksize != 0 ? (1UL << (nb_taxa%chunksize)) - 1 : ~0UL);
+  unsigned long word, invert;
+
+  /* a word of the bitsets at a time: the taxa on which the bipartitions differ are the bits of the XOR */
+  for(w = 0; w < nb_words; w++) {
+    word = a[w] ^ b[w];
+    if(w == nb_words-1) word &= last_mask;
+    nbdiff += __builtin_popcountl(word);
+  }
+  nbequ = nb_taxa - nbdiff;
+  /* taxa to move are those on which the bipartitions differ, or agree if the smaller set */
+  if(nbdiff < nbequ){
+    if(nbdiff != dist){
+      fprintf(stderr,"Length of moved species array (%d) is not equal to the minimum distance found (%d)\n", nbdiff, dist);
+      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+    }
+  } else if(nbequ != dist){
+    fprintf(stderr,"Length of moved species array (%d) is not equal to the minimum distance found (%d)\n", nbequ, dist);
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+  invert = (nbdiff < nbequ ? 0UL : ~0UL);
+  dist = 0;
+  for(w = 0; w < nb_words; w++) {
+    word = a[w] ^ b[w] ^ invert;
+    if(w == nb_words-1) word &= last_mask;
+    /* set bits in increasing order */
+    for(; word; word &= word - 1) species[dist++] = w * chunksize + __builtin_ctzl(word);
+  }
+}
+
+/* 
+   Index of the first bootstrap tree with the same unrooted topology as each bootstrap tree (itself if it is
+   the first one). The topologies are compared by the fingerprints of their splits, computed on the trees 
+   just parsed (the hashtables of complete_parse_nh are not needed). A tree that cannot be fingerprinted 
+   is only the same as itself. The parsed tree of the first tree of each topology is kept in parsed[i] (NULL 
+   for the others), to be completed by complete_parsed_tree instead of being parsed again.
+*/
+typedef struct topology_key{
+  fingerprint_t fp;
+  int tree;
+} topology_key;
+
+static int compare_topology_keys(const void *a, const void *b){
+  const topology_key *x = a, *y = b;
+  if(x->fp.hi != y->fp.hi) return (x->fp.hi < y->fp.hi ? -1 : 1);
+  if(x->fp.lo != y->fp.lo) return (x->fp.lo < y->fp.lo ? -1 : 1);
+  return x->tree - y->tree;
+}
+
+int* bootstrap_topologies(char **alt_tree_strings, char **taxname_lookup_table, int nb_taxa, int num_trees, int quiet, Tree **parsed){
+  int i, first, nb_unique = 0;
+  int *topology = malloc(num_trees * sizeof(int));
+  int *fingerprinted = malloc(num_trees * sizeof(int));
+  topology_key *keys = malloc(num_trees * sizeof(topology_key));
+  fingerprint_keys *taxon_keys = new_fingerprint_keys(nb_taxa, FINGERPRINT_SEED);
+  map_t taxmap = build_taxid_hashmap(taxname_lookup_table, nb_taxa);
+  Tree *tree;
+
+#pragma omp parallel for private(tree) shared(alt_tree_strings, keys, fingerprinted, taxon_keys, taxmap, nb_taxa, num_trees, parsed) schedule(dynamic)
+  for(i=0; i<num_trees; i++){
+    tree = parse_nh_string(alt_tree_strings[i]);
+    keys[i].tree = i;
+    fingerprinted[i] = (tree != NULL && tree->nb_taxa == nb_taxa && tree_topology_fingerprint(tree, taxon_keys, taxmap, &(keys[i].fp)));
+    if(!fingerprinted[i]) keys[i].fp.lo = keys[i].fp.hi = 0;
+    parsed[i] = tree;
+  }
+
+  qsort(keys, num_trees, sizeof(topology_key), compare_topology_keys);
+  for(i=0; i<num_trees; i++){
+    if(i == 0 || !fingerprinted[keys[i].tree] || !fingerprinted[keys[i-1].tree] || !fingerprint_equals(keys[i].fp, keys[i-1].fp)){
+      first = keys[i].tree;
+      nb_unique++;
+    }
+    topology[keys[i].tree] = first;
+  }
+  /* only the first tree of each topology is analyzed */
+  for(i=0; i<num_trees; i++){
+    if(topology[i] != i && parsed[i] != NULL){
+      free_tree(parsed[i]);
+      parsed[i] = NULL;
+    }
+  }
+  if(!quiet) fprintf(stderr,"Distinct bootstrap topologies: %d / %d\n", nb_unique, num_trees);
+
+  free_taxid_hashmap(taxmap);
+  free_fingerprint_keys(taxon_keys);
+  free(fingerprinted);
+  free(keys);
+  return topology;
+}
+
+/* number of trees of each topology, for the first tree of the topology, 0 for the others */
+int* topology_multiplicities(int *topology, int num_trees){
+  int i;
+  int *multiplicity = calloc(num_trees, sizeof(int));
+  for(i=0; i<num_trees; i++) multiplicity[topology[i]]++;
+  return multiplicity;
+}
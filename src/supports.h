@@ -0,0 +1,85 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _SUPPORTS_H_
+#define _SUPPORTS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "tree.h"
+#include "split_table.h"
+
+/*
+  Supports of the branches of reference trees over a set of bootstrap trees (given as newick strings): 
+  transfer (tbe) and Felsenstein (fbp) bootstrap, and their statistics. Each bootstrap tree is parsed once
+  and compared to all the reference trees, on the same taxa.
+*/
+
+/* buckets of the histograms of the normalized transfer distances (--hist): exactly 0, then ]0,0.1] ... ]0.9,1] */
+#define HIST_BUCKETS 10
+#define HIST_MAGIC "BHST"
+#define COUNT_MAGIC "BCNT"
+
+/* options of tbe(), filled once in main() */
+typedef struct tbe_options{
+  FILE *stat_file;        /* statistics of the branches and tIndex (-S), NULL if not asked */
+  FILE *hist_file;        /* histograms of the distances (--hist), NULL if not asked */
+  int hist_binary;        /* --hist-format bin */
+  FILE *count_file;       /* taxa moved around each branch (--count-file), NULL if not asked */
+  int count_binary;       /* --count-format bin */
+  int count_per_branch;   /* -c: the same counts, in the stat file */
+  double dist_cutoff;     /* -d: normalized distance of the close branches, for the tIndex */
+  int quiet;
+  int kernel;             /* TBE_KERNEL_* (workspace.h) */
+  int batch;              /* --batch: number of trees of a batch, 1 for none */
+  int huge_pages;         /* --huge-pages */
+  int cache_mem;          /* --cache-mem: size of the column cache in MB, 0 for none */
+  int dedup;              /* --dedup */
+} tbe_options;
+
+// TBE supports of the nb_refs reference trees, written as the names of their branches. The outputs of the
+// references follow each other in the stat, histogram and count files of opt (NULL if not asked). mean_dist[r] and 
+// nb_found[r], if not NULL, get the mean distance and the FBP count of each branch of the reference r
+void tbe(Tree **ref_trees, int nb_refs, double **mean_dist, int **nb_found, char **alt_tree_strings,char** taxname_lookup_table, int num_trees, const tbe_options *opt, split_table *st);
+// FBP supports of the nb_refs reference trees, a hashmap of the splits of each bootstrap tree being probed
+void fbp(Tree **ref_trees, int nb_refs, char **alt_tree_strings,char** taxname_lookup_table, int num_trees, int quiet, int dedup, split_table *st);
+// Same, with the splits of all the bootstrap trees in the split table st
+void fbp_table(Tree **ref_trees, int nb_refs, char **alt_tree_strings,char** taxname_lookup_table, int num_trees, int quiet, split_table *st);
+// Writes the proportion of trees containing each internal branch of the reference tree as its support
+void set_fbp_supports(Tree *ref_tree, int *nb_found, int num_trees);
+// Adds weight to found[r][j] for each branch j of the reference tree r that is in the bootstrap tree
+void fbp_count_tree(Tree **ref_trees, int nb_refs, Tree *alt_tree, int64_t **found, int weight);
+// Writes the mean transfer distance of each internal branch of the reference tree as its name, in the form id|avgdist|depth
+void set_raw_names(Tree *ref_tree, double *mean_dist, int num_trees);
+// Fills species with the ids of the species to move to go from one branch to the other
+// (the taxa on which the two bipartitions differ, in increasing order)
+void species_to_move(Edge* re, Edge* be, int dist, int nb_taxa, int *species);
+// First bootstrap tree with the same unrooted topology as each tree (--dedup). The first tree of each topology
+// is kept in parsed, as parsed by parse_nh_string (NULL for the other trees)
+int* bootstrap_topologies(char **alt_tree_strings, char **taxname_lookup_table, int nb_taxa, int num_trees, int quiet, Tree **parsed);
+// Number of trees of each topology, for the first tree of the topology, 0 for the others
+int* topology_multiplicities(int *topology, int num_trees);
+
+#endif
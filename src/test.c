@@ -28,6 +28,11 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "hashmap.h"
 #include "tree.h"
 #include "tree_utils.h"
+#include "split_table.h"
+#include "consensus.h"
+#include "transfer.h"
+#include "accumulator.h"
+#include "supports.h"
 
 /* Returns a table of all node ids of the tree, with 1 if they are taxon on the side of the edge, 0 if not (or internal) */
 int fill_all_taxa_ids(Node *node, Node *prev, int *output){
@@ -336,13 +341,11 @@ int test_transfer_1(){
   int n = ref_tree->nb_taxa;
   int m = ref_tree->nb_edges;
   int i;
-  short unsigned** c_matrix = (short unsigned**) malloc(m*sizeof(short unsigned*)); /* matrix of cardinals of complements */
-  for (i=0; i<m; i++) c_matrix[i] = (short unsigned*) malloc(max_branches_boot*sizeof(short unsigned));
   short unsigned** i_matrix = (short unsigned**) malloc(m*sizeof(short unsigned*)); /* matrix of cardinals of intersections */
   for (i=0; i<m; i++) i_matrix[i] = (short unsigned*) malloc(max_branches_boot*sizeof(short unsigned));
-  short unsigned** hamming = (short unsigned**) malloc(m*sizeof(short unsigned*)); /* matrix of Hamming distances */
-  for (i=0; i<m; i++) hamming[i] = (short unsigned*) malloc(max_branches_boot*sizeof(short unsigned));
   short unsigned* min_dist = (short unsigned*) malloc(m*sizeof(short unsigned)); /* array of min Hamming distances */
+  short unsigned* min_dist_edge = (short unsigned*) malloc(m*sizeof(short unsigned)); /* array of edge ids corresponding to min Hamming distances */
+  int* boot_leaf_edge = (int*) malloc(n*sizeof(int)); /* terminal edge of each taxon in the bootstrap tree */
 
   swap_tree = complete_parse_nh(swap_tree_string, &taxname_lookup_table); /* sets taxname_lookup_table en passant */
   for (i = 0; i < m; i++) {
@@ -351,9 +354,9 @@ int test_transfer_1(){
   min_num_moved = 3;
   e_index=8;
 
-  /* calculation of the C and I matrices (see Brehelin/Gascuel/Martin) */
-  update_all_i_c_post_order_ref_tree(ref_tree, swap_tree, i_matrix, c_matrix);
-  update_all_i_c_post_order_boot_tree(ref_tree, swap_tree, i_matrix, c_matrix, hamming, min_dist);
+  /* calculation of the I matrix (see Brehelin/Gascuel/Martin) */
+  update_all_i_post_order_ref_tree(ref_tree, swap_tree, i_matrix, min_dist, min_dist_edge, boot_leaf_edge);
+  update_all_i_post_order_boot_tree(ref_tree, swap_tree, i_matrix, min_dist, min_dist_edge);
   
   if(min_dist[e_index] > min_num_moved){
     fprintf(stderr,"TRANSFER Test 1 : Error : The min_dist of the swaped branch is > the number of swaped taxa %d>%d\n",min_dist[e_index],min_num_moved);
@@ -363,14 +366,12 @@ int test_transfer_1(){
   free_tree(swap_tree);
   
   for (i=0; i<m; i++) {
-    free(c_matrix[i]);
     free(i_matrix[i]);
-    free(hamming[i]);
   }
-  free(c_matrix);
   free(i_matrix);
-  free(hamming);
+  free(boot_leaf_edge);
   free(min_dist);
+  free(min_dist_edge);
   free_tree(ref_tree);
 
   fprintf(stderr,"TRANSFER Test 1 : OK\n");
@@ -401,13 +402,11 @@ int test_transfer_2(){
   int n = ref_tree->nb_taxa;
   int m = ref_tree->nb_edges;
   int i;
-  short unsigned** c_matrix = (short unsigned**) malloc(m*sizeof(short unsigned*)); /* matrix of cardinals of complements */
-  for (i=0; i<m; i++) c_matrix[i] = (short unsigned*) malloc(max_branches_boot*sizeof(short unsigned));
   short unsigned** i_matrix = (short unsigned**) malloc(m*sizeof(short unsigned*)); /* matrix of cardinals of intersections */
   for (i=0; i<m; i++) i_matrix[i] = (short unsigned*) malloc(max_branches_boot*sizeof(short unsigned));
-  short unsigned** hamming = (short unsigned**) malloc(m*sizeof(short unsigned*)); /* matrix of Hamming distances */
-  for (i=0; i<m; i++) hamming[i] = (short unsigned*) malloc(max_branches_boot*sizeof(short unsigned));
   short unsigned* min_dist = (short unsigned*) malloc(m*sizeof(short unsigned)); /* array of min Hamming distances */
+  short unsigned* min_dist_edge = (short unsigned*) malloc(m*sizeof(short unsigned)); /* array of edge ids corresponding to min Hamming distances */
+  int* boot_leaf_edge = (int*) malloc(n*sizeof(int)); /* terminal edge of each taxon in the bootstrap tree */
 
   for(r=0;r<100;r++){
     swap_tree = complete_parse_nh(ref_tree_string, &taxname_lookup_table); /* sets taxname_lookup_table en passant */
@@ -425,9 +424,9 @@ int test_transfer_2(){
     }
     min_num_moved = swap_branches(swap_tree,e);
 
-    /* calculation of the C and I matrices (see Brehelin/Gascuel/Martin) */
-    update_all_i_c_post_order_ref_tree(ref_tree, swap_tree, i_matrix, c_matrix);
-    update_all_i_c_post_order_boot_tree(ref_tree, swap_tree, i_matrix, c_matrix, hamming, min_dist);
+    /* calculation of the I matrix (see Brehelin/Gascuel/Martin) */
+    update_all_i_post_order_ref_tree(ref_tree, swap_tree, i_matrix, min_dist, min_dist_edge, boot_leaf_edge);
+    update_all_i_post_order_boot_tree(ref_tree, swap_tree, i_matrix, min_dist, min_dist_edge);
 
     if(min_dist[e_index] > min_num_moved){
       fprintf(stderr,"TRANSFER Test 2 after branch swap : Error : The min_dist of the swaped branch is > the number of swaped taxa\n");
@@ -438,14 +437,12 @@ int test_transfer_2(){
   }
   
   for (i=0; i<m; i++) {
-    free(c_matrix[i]);
     free(i_matrix[i]);
-    free(hamming[i]);
   }
-  free(c_matrix);
   free(i_matrix);
-  free(hamming);
+  free(boot_leaf_edge);
   free(min_dist);
+  free(min_dist_edge);
 
   fprintf(stderr,"TRANSFER Test 2 : OK\n");
 
@@ -475,13 +472,11 @@ int test_transfer_3(){
   int n = ref_tree->nb_taxa;
   int m = ref_tree->nb_edges;
   int i;
-  short unsigned** c_matrix = (short unsigned**) malloc(m*sizeof(short unsigned*)); /* matrix of cardinals of complements */
-  for (i=0; i<m; i++) c_matrix[i] = (short unsigned*) malloc(max_branches_boot*sizeof(short unsigned));
   short unsigned** i_matrix = (short unsigned**) malloc(m*sizeof(short unsigned*)); /* matrix of cardinals of intersections */
   for (i=0; i<m; i++) i_matrix[i] = (short unsigned*) malloc(max_branches_boot*sizeof(short unsigned));
-  short unsigned** hamming = (short unsigned**) malloc(m*sizeof(short unsigned*)); /* matrix of Hamming distances */
-  for (i=0; i<m; i++) hamming[i] = (short unsigned*) malloc(max_branches_boot*sizeof(short unsigned));
   short unsigned* min_dist = (short unsigned*) malloc(m*sizeof(short unsigned)); /* array of min Hamming distances */
+  short unsigned* min_dist_edge = (short unsigned*) malloc(m*sizeof(short unsigned)); /* array of edge ids corresponding to min Hamming distances */
+  int* boot_leaf_edge = (int*) malloc(n*sizeof(int)); /* terminal edge of each taxon in the bootstrap tree */
 
   swap_tree = complete_parse_nh(swap_tree_string, &taxname_lookup_table); /* sets taxname_lookup_table en passant */
   for (i = 0; i < m; i++) {
@@ -490,9 +485,9 @@ int test_transfer_3(){
   min_num_moved = 4;
   e_index=6;
 
-  /* calculation of the C and I matrices (see Brehelin/Gascuel/Martin) */
-  update_all_i_c_post_order_ref_tree(ref_tree, swap_tree, i_matrix, c_matrix);
-  update_all_i_c_post_order_boot_tree(ref_tree, swap_tree, i_matrix, c_matrix, hamming, min_dist);
+  /* calculation of the I matrix (see Brehelin/Gascuel/Martin) */
+  update_all_i_post_order_ref_tree(ref_tree, swap_tree, i_matrix, min_dist, min_dist_edge, boot_leaf_edge);
+  update_all_i_post_order_boot_tree(ref_tree, swap_tree, i_matrix, min_dist, min_dist_edge);
   
   if(min_dist[e_index] != min_num_moved){
     fprintf(stderr,"TRANSFER Test 3 : Error : The min_dist of the internal branch is != %d (%d)\n",min_num_moved,min_dist[e_index]);
@@ -508,9 +503,9 @@ int test_transfer_3(){
   min_num_moved = 5;
   e_index=6;
 
-  /* calculation of the C and I matrices (see Brehelin/Gascuel/Martin) */
-  update_all_i_c_post_order_ref_tree(ref_tree, swap_tree, i_matrix, c_matrix);
-  update_all_i_c_post_order_boot_tree(ref_tree, swap_tree, i_matrix, c_matrix, hamming, min_dist);
+  /* calculation of the I matrix (see Brehelin/Gascuel/Martin) */
+  update_all_i_post_order_ref_tree(ref_tree, swap_tree, i_matrix, min_dist, min_dist_edge, boot_leaf_edge);
+  update_all_i_post_order_boot_tree(ref_tree, swap_tree, i_matrix, min_dist, min_dist_edge);
   
   if(min_dist[e_index] != min_num_moved){
     fprintf(stderr,"TRANSFER Test 3 : Error : The min_dist of the internal branch is != %d (%d)\n",min_num_moved,min_dist[e_index]);
@@ -521,14 +516,12 @@ int test_transfer_3(){
 
 
   for (i=0; i<m; i++) {
-    free(c_matrix[i]);
     free(i_matrix[i]);
-    free(hamming[i]);
   }
-  free(c_matrix);
   free(i_matrix);
-  free(hamming);
+  free(boot_leaf_edge);
   free(min_dist);
+  free(min_dist_edge);
   free_tree(ref_tree);
 
   fprintf(stderr,"TRANSFER Test 3 : OK\n");
@@ -588,22 +581,20 @@ int test_transfer_4(){
     int m = ref_tree->nb_edges;
     int max_branches_boot = ref_tree->nb_taxa*2-2;
     
-    short unsigned** c_matrix = (short unsigned**) malloc(m*sizeof(short unsigned*)); /* matrix of cardinals of complements */
     short unsigned** i_matrix = (short unsigned**) malloc(m*sizeof(short unsigned*)); /* matrix of cardinals of intersections */
-    short unsigned** hamming = (short unsigned**) malloc(m*sizeof(short unsigned*)); /* matrix of Hamming distances */
     short unsigned* min_dist = (short unsigned*) malloc(m*sizeof(short unsigned)); /* array of min Hamming distances */
+    short unsigned* min_dist_edge = (short unsigned*) malloc(m*sizeof(short unsigned)); /* array of edge ids corresponding to min Hamming distances */
+    int* boot_leaf_edge = (int*) malloc(n*sizeof(int)); /* terminal edge of each taxon in the bootstrap tree */
     
-    for (i=0; i<m; i++) c_matrix[i] = (short unsigned*) malloc(max_branches_boot*sizeof(short unsigned));
     for (i=0; i<m; i++) i_matrix[i] = (short unsigned*) malloc(max_branches_boot*sizeof(short unsigned));
-    for (i=0; i<m; i++) hamming[i]  = (short unsigned*) malloc(max_branches_boot*sizeof(short unsigned));
     
     for(i_swap = 0; i_swap < n_swap; i_swap++){
       for (i = 0; i < m; i++) {
 	min_dist[i] = n; /* initialization to the nb of taxa */
       }
       /* First we see if the min dist is 0 for all branches (it must be) */
-      update_all_i_c_post_order_ref_tree(ref_tree, swap_tree, i_matrix, c_matrix);
-      update_all_i_c_post_order_boot_tree(ref_tree, swap_tree, i_matrix, c_matrix, hamming, min_dist);
+      update_all_i_post_order_ref_tree(ref_tree, swap_tree, i_matrix, min_dist, min_dist_edge, boot_leaf_edge);
+      update_all_i_post_order_boot_tree(ref_tree, swap_tree, i_matrix, min_dist, min_dist_edge);
     
       for(i_edge=0; i_edge<ref_tree->nb_edges;i_edge++){
 	if(min_dist[i_edge] != 0){
@@ -633,8 +624,8 @@ int test_transfer_4(){
 	min_dist[i] = n; /* initialization to the nb of taxa */
       }
     
-      update_all_i_c_post_order_ref_tree(ref_tree, swap_tree, i_matrix, c_matrix);
-      update_all_i_c_post_order_boot_tree(ref_tree, swap_tree, i_matrix, c_matrix, hamming, min_dist);
+      update_all_i_post_order_ref_tree(ref_tree, swap_tree, i_matrix, min_dist, min_dist_edge, boot_leaf_edge);
+      update_all_i_post_order_boot_tree(ref_tree, swap_tree, i_matrix, min_dist, min_dist_edge);
     
       /* fprintf(stderr,"\tTRANSFER Test 4 : The min_dist of the internal branch is %d\n",min_dist[edge]); */
     
@@ -656,20 +647,386 @@ int test_transfer_4(){
     }
     
     for (i=0; i<m; i++) {
-      free(c_matrix[i]);
       free(i_matrix[i]);
-      free(hamming[i]);
     }
-    free(c_matrix);
     free(i_matrix);
-    free(hamming);
+    free(boot_leaf_edge);
     free(min_dist);
+    free(min_dist_edge);
     free_tree(ref_tree);
     free_tree(swap_tree);
   }
   return EXIT_SUCCESS;
 }
 
+/* Transfer distance between the bipartitions of two edges, computed from their bitsets */
+int test_transfer_distance(Edge *e1, Edge *e2, int nb_taxa){
+  int t, dist = 0;
+  for(t=0; t<nb_taxa; t++){
+    dist += (lookup_id(e1->hashtbl[1],t) != lookup_id(e2->hashtbl[1],t));
+  }
+  if(dist > nb_taxa/2) dist = nb_taxa - dist;
+  return dist;
+}
+
+/**
+   We test the min transfer distances of the I matrix kernel against a brute force
+   computation, on random trees. The kernels working on the ref index must give the same 
+   distances and edges as the I matrix kernel, the column one with at most log2(n)+2 columns.
+ */
+int test_transfer_random(){
+  int trial, i, j, n, m, dist, min;
+  Tree *seed_tree, *ref_tree, *boot_tree;
+  short unsigned **i_matrix, *min_dist, *min_dist_edge;
+  int *boot_leaf_edge;
+  tbe_workspace *ws, *dense_ws, *popcount_ws, *fast_ws, *sparse_ws, *batch_ws, *contract_ws, *rows_ws, *w;
+  ref_index *ref;
+
+  for(trial=0; trial<10; trial++){
+    n = 8 + trial * 9;
+    seed_tree = gen_rand_tree(n, NULL);
+    ref_tree = gen_random_tree(seed_tree);
+    /* the first bootstrap tree is the reference tree itself */
+    boot_tree = (trial == 0 ? ref_tree : gen_random_tree(seed_tree));
+    m = ref_tree->nb_edges;
+    i_matrix = (short unsigned**) malloc(m*sizeof(short unsigned*));
+    for (i=0; i<m; i++) i_matrix[i] = (short unsigned*) malloc((2*n-2)*sizeof(short unsigned));
+    min_dist = (short unsigned*) malloc(m*sizeof(short unsigned));
+    min_dist_edge = (short unsigned*) malloc(m*sizeof(short unsigned));
+    boot_leaf_edge = (int*) malloc(n*sizeof(int));
+    for (i=0; i<m; i++) min_dist[i] = n;
+
+    update_all_i_post_order_ref_tree(ref_tree, boot_tree, i_matrix, min_dist, min_dist_edge, boot_leaf_edge);
+    update_all_i_post_order_boot_tree(ref_tree, boot_tree, i_matrix, min_dist, min_dist_edge);
+
+    /* 0: dense kernel on the ref index, 1 and 2: column kernel, twice in the same workspace to check 
+       that nothing leaks from one tree to the next, 3: batch kernel on this tree alone,
+       4: popcount kernel, 5: fast kernel, 6: sparse kernel, for the edges of depth up to n/4, 
+       7: contract kernel (the whole tree is common in the first trial), 8: rows kernel, in blocks of 32 rows */
+    ref = new_ref_index(ref_tree);
+    ref_index_add_clades(ref);
+    ref_index_add_steps(ref);
+    ref_index_add_sparse(ref, n);
+    ref_index_add_parts(ref, 3);
+    dense_ws = new_tbe_workspace(n, m, ref->nb_internal, TBE_KERNEL_DENSE, 0);
+    ws = new_tbe_workspace(n, m, ref->nb_internal, TBE_KERNEL_COLUMNS, 0);
+    popcount_ws = new_tbe_workspace(n, m, ref->nb_internal, TBE_KERNEL_POPCOUNT, 0);
+    fast_ws = new_tbe_workspace(n, m, ref->nb_internal, TBE_KERNEL_FAST, 0);
+    sparse_ws = new_tbe_workspace(n, m, ref->nb_internal, TBE_KERNEL_SPARSE, 0);
+    batch_ws = new_tbe_workspace(n, m, ref->nb_internal, TBE_KERNEL_BATCH, 0);
+    contract_ws = new_tbe_workspace(n, m, ref->nb_internal, TBE_KERNEL_CONTRACT, 0);
+    rows_ws = new_tbe_workspace(n, m, ref->nb_internal, TBE_KERNEL_ROWS, 0);
+    tbe_workspace_add_parts(rows_ws, ref, 0);
+    for (j=0; j<9; j++) {
+      if(j == 0){
+	min_transfer_distances_dense(ref, boot_tree, dense_ws);
+      } else if(j == 4){
+	min_transfer_distances(ref, boot_tree, popcount_ws);
+      } else if(j == 5){
+	min_transfer_distances(ref, boot_tree, fast_ws);
+      } else if(j == 6){
+	min_transfer_distances(ref, boot_tree, sparse_ws);
+      } else if(j == 7){
+	min_transfer_distances(ref, boot_tree, contract_ws);
+      } else if(j == 8){
+	min_transfer_distances(ref, boot_tree, rows_ws);
+      } else if(j == 3){
+	tbe_batch_compile(boot_tree, batch_ws);
+	min_transfer_distances_batch(ref, &batch_ws, 1);
+      } else {
+	min_transfer_distances_columns(ref, boot_tree, ws);
+	if(ws->max_live > tbe_nb_columns(n)){
+	  fprintf(stderr,"TRANSFER Random Test : Error : %d columns used at the same time, for %d taxa\n",ws->max_live,n);
+	  return EXIT_FAILURE;
+	}
+      }
+      w = (j == 0 ? dense_ws : (j == 3 ? batch_ws : (j == 4 ? popcount_ws : (j == 5 ? fast_ws : (j == 6 ? sparse_ws : (j == 7 ? contract_ws : (j == 8 ? rows_ws : ws)))))));
+      for (i=0; i<m; i++) {
+	if(w->min_dist[i] != min_dist[i] || w->min_dist_edge[i] != min_dist_edge[i]){
+	  fprintf(stderr,"TRANSFER Random Test : Error : Kernel %d gives %d (edge %d) for edge %d instead of %d (edge %d)\n",
+		  j,w->min_dist[i],w->min_dist_edge[i],i,min_dist[i],min_dist_edge[i]);
+	  return EXIT_FAILURE;
+	}
+      }
+    }
+    free_tbe_workspace(ws);
+    free_tbe_workspace(dense_ws);
+    free_tbe_workspace(popcount_ws);
+    free_tbe_workspace(fast_ws);
+    free_tbe_workspace(sparse_ws);
+    free_tbe_workspace(batch_ws);
+    free_tbe_workspace(rows_ws);
+    free_tbe_workspace(contract_ws);
+    free_ref_index(ref);
+
+    for (i=0; i<m; i++) {
+      min = n;
+      for (j=0; j<boot_tree->nb_edges; j++) {
+	dist = test_transfer_distance(ref_tree->a_edges[i], boot_tree->a_edges[j], n);
+	if(dist < min) min = dist;
+      }
+      if(min_dist[i] != min){
+	fprintf(stderr,"TRANSFER Random Test : Error : The min_dist of edge %d is %d and should be %d\n",i,min_dist[i],min);
+	return EXIT_FAILURE;
+      }
+      if(test_transfer_distance(ref_tree->a_edges[i], boot_tree->a_edges[min_dist_edge[i]], n) != min){
+	fprintf(stderr,"TRANSFER Random Test : Error : The min_dist_edge of edge %d is not at distance %d\n",i,min);
+	return EXIT_FAILURE;
+      }
+    }
+
+    for (i=0; i<m; i++) free(i_matrix[i]);
+    free(i_matrix);
+    free(boot_leaf_edge);
+    free(min_dist);
+    free(min_dist_edge);
+    if(boot_tree != ref_tree) free_tree(boot_tree);
+    free_tree(ref_tree);
+    free_tree(seed_tree);
+  }
+  fprintf(stderr,"TRANSFER Random Test : OK\n");
+  return EXIT_SUCCESS;
+}
+
+/**
+   We test the batch kernel against the column kernel, on a batch of random trees 
+   large enough for the ref rows to be split in several tiles. The ref tree itself is 
+   in the batch, and the last run is on a smaller batch in the same workspaces.
+ */
+int test_transfer_batch(){
+  int t, i, n = 1500, nb_trees = 4, nb;
+  Tree *seed_tree, *ref_tree, *boot_trees[4];
+  tbe_workspace *ws, *batch_ws[4];
+  ref_index *ref;
+
+  seed_tree = gen_rand_tree(n, NULL);
+  ref_tree = gen_random_tree(seed_tree);
+  ref = new_ref_index(ref_tree);
+  ws = new_tbe_workspace(n, ref_tree->nb_edges, ref->nb_internal, TBE_KERNEL_COLUMNS, 0);
+  for(t=0; t<nb_trees; t++){
+    boot_trees[t] = (t == 1 ? ref_tree : gen_random_tree(seed_tree));
+    batch_ws[t] = new_tbe_workspace(n, ref_tree->nb_edges, ref->nb_internal, TBE_KERNEL_BATCH, 0);
+  }
+  for(nb=nb_trees; nb>=2; nb-=2){
+    for(t=0; t<nb; t++) tbe_batch_compile(boot_trees[nb_trees-nb+t], batch_ws[t]);
+    min_transfer_distances_batch(ref, batch_ws, nb);
+    for(t=0; t<nb; t++){
+      min_transfer_distances_columns(ref, boot_trees[nb_trees-nb+t], ws);
+      for(i=0; i<ref_tree->nb_edges; i++){
+	if(batch_ws[t]->min_dist[i] != ws->min_dist[i] || batch_ws[t]->min_dist_edge[i] != ws->min_dist_edge[i]){
+	  fprintf(stderr,"TRANSFER Batch Test : Error : Tree %d gives %d (edge %d) for edge %d instead of %d (edge %d)\n",
+		  nb_trees-nb+t,batch_ws[t]->min_dist[i],batch_ws[t]->min_dist_edge[i],i,ws->min_dist[i],ws->min_dist_edge[i]);
+	  return EXIT_FAILURE;
+	}
+      }
+    }
+  }
+  for(t=0; t<nb_trees; t++){
+    free_tbe_workspace(batch_ws[t]);
+    if(boot_trees[t] != ref_tree) free_tree(boot_trees[t]);
+  }
+  free_tbe_workspace(ws);
+  free_ref_index(ref);
+  free_tree(ref_tree);
+  free_tree(seed_tree);
+  fprintf(stderr,"TRANSFER Batch Test : OK\n");
+  return EXIT_SUCCESS;
+}
+
+/**
+   The column kernel with a column cache gives the same results as without, the trees being seen 
+   twice (the subtrees of the second pass are found in the cache), with a large cache and 
+   with a cache of a single entry (always replaced).
+ */
+int test_transfer_cache(){
+  int t, c, i, n = 600, nb_trees = 3;
+  long lookups, hits;
+  Tree *seed_tree, *ref_tree, *boot_trees[3];
+  tbe_workspace *ws, *cached_ws;
+  column_cache *cache;
+  ref_index *ref;
+
+  seed_tree = gen_rand_tree(n, NULL);
+  ref_tree = gen_random_tree(seed_tree);
+  ref = new_ref_index(ref_tree);
+  ref_index_add_fingerprints(ref);
+  ws = new_tbe_workspace(n, ref_tree->nb_edges, ref->nb_internal, TBE_KERNEL_COLUMNS, 0);
+  for(t=0; t<nb_trees; t++) boot_trees[t] = (t == 1 ? ref_tree : gen_random_tree(seed_tree));
+  for(c=0; c<2; c++){
+    cache = new_column_cache(ref->nb_internal, (c == 0 ? 64UL << 20 : 10 * ref->nb_internal), 4);
+    cached_ws = new_tbe_workspace(n, ref_tree->nb_edges, ref->nb_internal, TBE_KERNEL_COLUMNS, 0);
+    tbe_workspace_add_cache(cached_ws, cache);
+    for(t=0; t<2*nb_trees; t++){
+      min_transfer_distances_columns(ref, boot_trees[t % nb_trees], ws);
+      min_transfer_distances_columns(ref, boot_trees[t % nb_trees], cached_ws);
+      for(i=0; i<ref_tree->nb_edges; i++){
+	if(cached_ws->min_dist[i] != ws->min_dist[i] || cached_ws->min_dist_edge[i] != ws->min_dist_edge[i]){
+	  fprintf(stderr,"TRANSFER Cache Test : Error : Tree %d gives %d (edge %d) for edge %d instead of %d (edge %d)\n",
+		  t,cached_ws->min_dist[i],cached_ws->min_dist_edge[i],i,ws->min_dist[i],ws->min_dist_edge[i]);
+	  return EXIT_FAILURE;
+	}
+      }
+    }
+    column_cache_stats(cache, &lookups, &hits);
+    if(c == 0 && hits == 0){
+      fprintf(stderr,"TRANSFER Cache Test : Error : No subtree found in the cache (%ld lookups)\n",lookups);
+      return EXIT_FAILURE;
+    }
+    free_tbe_workspace(cached_ws);
+    free_column_cache(cache);
+  }
+  for(t=0; t<nb_trees; t++){
+    if(boot_trees[t] != ref_tree) free_tree(boot_trees[t]);
+  }
+  free_tbe_workspace(ws);
+  free_ref_index(ref);
+  free_tree(ref_tree);
+  free_tree(seed_tree);
+  fprintf(stderr,"TRANSFER Cache Test : OK\n");
+  return EXIT_SUCCESS;
+}
+
+/**
+   We test the vectorized inner loops of the transfer kernels against the portable ones,
+   on random (but consistent) columns, up to 65535 taxa, and lengths that are not multiple of the vectors.
+ */
+int test_transfer_simd(){
+  int trial, level, k, c, nb, n, card[2], lo, hi, rank;
+  short unsigned *items, *column[2], *add[2], *leaf[2], *first, *span;
+  uint32_t *keys[2];
+
+  for(trial=0; trial<20; trial++){
+    n = (trial % 2 ? 65535 : 4 + rand_to(1000));
+    nb = 1 + rand_to(200);
+    items = malloc(nb*sizeof(short unsigned));
+    for(k=0; k<nb; k++) items[k] = 1 + rand_to(n-1);
+    /* clade intervals, some of them starting or ending at the rank of the leaf */
+    rank = rand_to(n);
+    first = malloc(nb*sizeof(short unsigned));
+    span = malloc(nb*sizeof(short unsigned));
+    for(k=0; k<nb; k++){
+      first[k] = (k % 5 == 0 ? rank : rand_to(n));
+      span[k] = (k % 7 == 0 && rank >= first[k] ? rank - first[k] : rand_to(n - first[k]));
+    }
+    /* two boot clades: the intersection with ref clade k is between items+card-n and min(items,card) */
+    for(c=0; c<2; c++){
+      card[c] = 1 + rand_to(n-1);
+      column[c] = malloc(nb*sizeof(short unsigned));
+      for(k=0; k<nb; k++){
+	lo = items[k] + card[c] - n > 0 ? items[k] + card[c] - n : 0;
+	hi = items[k] < card[c] ? items[k] : card[c];
+	column[c][k] = lo + rand_to(hi-lo+1);
+      }
+    }
+    for(level=TBE_SIMD_SCALAR; level<=TBE_SIMD_AVX512; level++){
+      if(tbe_simd_select(level) == -1) continue;
+      /* c=0: this level, c=1: scalar */
+      for(c=0; c<2; c++){
+	if(c == 1) tbe_simd_select(TBE_SIMD_SCALAR);
+	add[c] = malloc(nb*sizeof(short unsigned));
+	keys[c] = malloc(nb*sizeof(uint32_t));
+	leaf[c] = malloc(nb*sizeof(short unsigned));
+	tbe_interval_to_column(nb, first, span, rank, leaf[c]);
+	memcpy(add[c], column[0], nb*sizeof(short unsigned));
+	tbe_column_add(nb, add[c], column[1]);
+	memset(keys[c], 0xff, nb*sizeof(uint32_t));
+	tbe_column_min_keys(nb, items, column[0], card[0], n, 12345, keys[c]);
+	tbe_column_min_keys(nb, items, column[1], card[1], n, 54321, keys[c]);
+      }
+      if(memcmp(add[0], add[1], nb*sizeof(short unsigned)) || memcmp(keys[0], keys[1], nb*sizeof(uint32_t))
+	 || memcmp(leaf[0], leaf[1], nb*sizeof(short unsigned))){
+	fprintf(stderr,"TRANSFER SIMD Test : Error : %s kernel differs from the scalar one (%d taxa, %d edges)\n", tbe_simd_name(level), n, nb);
+	return EXIT_FAILURE;
+      }
+      for(c=0; c<2; c++){
+	free(add[c]);
+	free(keys[c]);
+	free(leaf[c]);
+      }
+    }
+    free(items);
+    free(first);
+    free(span);
+    free(column[0]);
+    free(column[1]);
+  }
+  tbe_simd_select(TBE_SIMD_AUTO);
+  fprintf(stderr,"TRANSFER SIMD Test : OK\n");
+  return EXIT_SUCCESS;
+}
+
+/* Writes at *pos a balanced newick subtree on the taxa t<first> ... t<last-1> */
+void test_balanced_newick(char *s, int *pos, int first, int last){
+  int middle = (first + last) / 2;
+  if(last - first == 1){
+    *pos += sprintf(s + *pos, "t%d:1", first);
+    return;
+  }
+  s[(*pos)++] = '(';
+  test_balanced_newick(s, pos, first, middle);
+  s[(*pos)++] = ',';
+  test_balanced_newick(s, pos, middle, last);
+  *pos += sprintf(s + *pos, "):1");
+}
+
+/**
+   The fast kernel compares |A xor B| and n - |A xor B|, that go up to n, before keeping the smaller one:
+   with a reference clade of more than 32768 taxa, it gives the same distances as the column kernel. 
+   The reference tree is (bal(0..33000),bal(33000..33200),bal(33200..33400)), and the bootstrap tree 
+   is a star of 167 balanced groups of 200 taxa.
+ */
+int test_transfer_large(){
+  int i, pos, n = 33400;
+  char *ref_string = malloc(20 * n), *boot_string = malloc(20 * n);
+  char **taxname_lookup_table = NULL;
+  Tree *ref_tree, *boot_tree;
+  tbe_workspace *ws, *fast_ws;
+  ref_index *ref;
+
+  pos = 0;
+  ref_string[pos++] = '(';
+  test_balanced_newick(ref_string, &pos, 0, 33000);
+  ref_string[pos++] = ',';
+  test_balanced_newick(ref_string, &pos, 33000, 33200);
+  ref_string[pos++] = ',';
+  test_balanced_newick(ref_string, &pos, 33200, n);
+  sprintf(ref_string + pos, ");");
+  /* every bootstrap clade has at most 200 taxa: |A xor B| > 32768 for the clade A of 33000 taxa */
+  pos = 0;
+  for(i=0; i<n; i+=200){
+    boot_string[pos++] = (i == 0 ? '(' : ',');
+    test_balanced_newick(boot_string, &pos, i, i+200);
+  }
+  sprintf(boot_string + pos, ");");
+
+  ref_tree = complete_parse_nh(ref_string, &taxname_lookup_table);
+  boot_tree = complete_parse_nh(boot_string, &taxname_lookup_table);
+  ref = new_ref_index(ref_tree);
+  ref_index_add_steps(ref);
+  ws = new_tbe_workspace(n, ref_tree->nb_edges, ref->nb_internal, TBE_KERNEL_COLUMNS, 0);
+  fast_ws = new_tbe_workspace(n, ref_tree->nb_edges, ref->nb_internal, TBE_KERNEL_FAST, 0);
+  min_transfer_distances_columns(ref, boot_tree, ws);
+  min_transfer_distances(ref, boot_tree, fast_ws);
+  for(i=0; i<ref_tree->nb_edges; i++){
+    if(fast_ws->min_dist[i] != ws->min_dist[i] || fast_ws->min_dist_edge[i] != ws->min_dist_edge[i]){
+      fprintf(stderr,"TRANSFER Large Test : Error : Fast kernel gives %d (edge %d) for edge %d (depth %d) instead of %d (edge %d)\n",
+	      fast_ws->min_dist[i],fast_ws->min_dist_edge[i],i,ref_tree->a_edges[i]->topo_depth,ws->min_dist[i],ws->min_dist_edge[i]);
+      return EXIT_FAILURE;
+    }
+  }
+  free_tbe_workspace(ws);
+  free_tbe_workspace(fast_ws);
+  free_ref_index(ref);
+  free_tree(boot_tree);
+  free_tree(ref_tree);
+  for(i=0; i<n; i++) free(taxname_lookup_table[i]);
+  free(taxname_lookup_table);
+  free(ref_string);
+  free(boot_string);
+  fprintf(stderr,"TRANSFER Large Test : OK\n");
+  return EXIT_SUCCESS;
+}
+
 int test_randomtree(){
   srand(time(NULL));
     char *ref_tree_string = "((a:1,b:1):1,e:1,(c:1,d:1):1);"; 
@@ -1369,6 +1726,472 @@ int test_hashmap(){
   return(EXIT_SUCCESS);
 }
 
+/**
+   We test the global split table against a direct comparison of the bipartitions
+   The second bootstrap tree is rooted: its two root edges define the same split, 
+   which must be counted once.
+ */
+int test_split_table(){
+  char *ref_tree_string = "((a:1,b:1):1,c:1,(d:1,e:1):1);";
+  char *boot_tree_strings[3] = {"(e:1,d:1,(c:1,(b:1,a:1):1):1);",
+				"((a:1,b:1):1,(c:1,(d:1,e:1):1):1);",
+				"((a:1,c:1):1,b:1,(d:1,e:1):1);"};
+  char** taxname_lookup_table = NULL;
+  Tree* ref_tree = complete_parse_nh(ref_tree_string, &taxname_lookup_table);
+  Tree* boot_tree;
+  split_table *st = new_split_table(ref_tree->nb_taxa, 4, 0);
+  int *counts = calloc(ref_tree->nb_edges, sizeof(int));
+  int *expected = calloc(ref_tree->nb_edges, sizeof(int));
+  int i, j, t;
+
+  for(t=0; t<3; t++){
+    boot_tree = complete_parse_nh(boot_tree_strings[t], &taxname_lookup_table);
+    split_table_add_tree(st, boot_tree, t);
+    for (i = 0; i < ref_tree->nb_edges; i++) {
+      for (j = 0; j < boot_tree->nb_edges; j++) {
+	if (equal_or_complement_id_hashtables(ref_tree->a_edges[i]->hashtbl[1],
+					      boot_tree->a_edges[j]->hashtbl[1],
+					      ref_tree->nb_taxa)) {
+	  expected[i]++;
+	  break;
+	}
+      }
+    }
+    free_tree(boot_tree);
+  }
+
+  split_table_tree_counts(st, ref_tree, counts);
+  for (i = 0; i < ref_tree->nb_edges; i++) {
+    if(counts[i] != expected[i]){
+      fprintf(stderr,"Test split table: error - Edge %d is found in %d trees and should be in %d\n",i,counts[i],expected[i]);
+      return(EXIT_FAILURE);
+    }
+    if(ref_tree->a_edges[i]->right->nneigh > 1 && ref_tree->a_edges[i]->hashtbl[1]->num_items == 2 
+       && counts[i] != (lookup_id(ref_tree->a_edges[i]->hashtbl[1], 0) ? 2 : 3)){
+      fprintf(stderr,"Test split table: error - Internal edge %d is found in %d trees\n",i,counts[i]);
+      return(EXIT_FAILURE);
+    }
+  }
+  if(st->nb_trees != 3){
+    fprintf(stderr,"Test split table: error - %d trees in the table instead of 3\n",st->nb_trees);
+    return(EXIT_FAILURE);
+  }
+  free_split_table(st);
+  free(counts);
+  free(expected);
+  free_tree(ref_tree);
+  fprintf(stderr,"Test split table: OK\n");
+  return(EXIT_SUCCESS);
+}
+
+/**
+   We test the per-thread accumulators: the same sums whatever the number of threads (rows) and the 
+   items each one got, and the fixed point fractions.
+ */
+int test_thread_accumulator(){
+  int nb_threads, t, i, len = 1000;
+  int64_t *sum, expected;
+  thread_accumulator *acc;
+
+  for(nb_threads=1; nb_threads<=7; nb_threads+=3){
+    acc = new_thread_accumulator(nb_threads, len);
+    for(i=0; i<len*10; i++){
+      t = (i * 7919) % nb_threads;
+      thread_accumulator_row(acc, t)[i % len] += i;
+    }
+    sum = thread_accumulator_reduce(acc);
+    for(i=0; i<len; i++){
+      /* i + (i+len) + ... + (i+9len) */
+      expected = 10*i + 45*len;
+      if(sum[i] != expected){
+	fprintf(stderr,"Test thread accumulator: error - %d threads: sum %d is %ld instead of %ld\n",nb_threads,i,(long)sum[i],(long)expected);
+	return(EXIT_FAILURE);
+      }
+    }
+    free_thread_accumulator(acc);
+  }
+  if(accumulator_fixed(1, 2) != ACCUMULATOR_ONE/2 || accumulator_fixed(3, 3) != ACCUMULATOR_ONE
+     || accumulator_fixed(1, 3) + accumulator_fixed(2, 3) != ACCUMULATOR_ONE){
+    fprintf(stderr,"Test thread accumulator: error - wrong fixed point fractions\n");
+    return(EXIT_FAILURE);
+  }
+  /* sparse counters: the same keys added by several threads are merged, and sorted */
+  sparse_accumulator *sparse = new_sparse_accumulator(3);
+  sparse_entry *entries;
+  long nb;
+  for(i=0; i<len*10; i++) sparse_accumulator_add(sparse, i % 3, (int64_t)(i % len) * 1000003, i);
+  nb = sparse_accumulator_reduce(sparse, &entries);
+  if(nb != len){
+    fprintf(stderr,"Test thread accumulator: error - %ld sparse counters instead of %d\n",nb,len);
+    return(EXIT_FAILURE);
+  }
+  for(i=0; i<len; i++){
+    if(entries[i].key != (int64_t)i * 1000003 || entries[i].value != 10*i + 45*len){
+      fprintf(stderr,"Test thread accumulator: error - sparse counter %d is %ld:%ld\n",i,(long)entries[i].key,(long)entries[i].value);
+      return(EXIT_FAILURE);
+    }
+  }
+  free(entries);
+  free_sparse_accumulator(sparse);
+  fprintf(stderr,"Test thread accumulator: OK\n");
+  return(EXIT_SUCCESS);
+}
+
+/**
+   We test the fingerprints of unrooted topologies: the same splits, rooted and ordered differently, 
+   give the same fingerprint, and different splits different fingerprints.
+ */
+int test_topology_fingerprint(){
+  char *ref_tree_string = "((a:1,b:1):1,c:1,(d:1,e:1):1);";
+  char *tree_strings[5] = {"(e:1,d:1,(c:1,(b:1,a:1):1):1);",
+			   "((a:1,b:1):1,(c:1,(d:1,e:1):1):1);",
+			   "(c,(a,b)0.9,(e,d)0.3);",
+			   "((a:1,c:1):1,b:1,(d:1,e:1):1);",
+			   "((a:1,b:1):1,(c:1,d:1):1,e:1);"};
+  int same[5] = {1, 1, 1, 0, 0};
+  char** taxname_lookup_table = NULL;
+  Tree* ref_tree = complete_parse_nh(ref_tree_string, &taxname_lookup_table);
+  fingerprint_keys *keys = new_fingerprint_keys(ref_tree->nb_taxa, FINGERPRINT_SEED);
+  map_t taxmap = build_taxid_hashmap(taxname_lookup_table, ref_tree->nb_taxa);
+  fingerprint_t ref_fp, fp;
+  Tree *tree;
+  int t;
+
+  tree = parse_nh_string(ref_tree_string);
+  if(!tree_topology_fingerprint(tree, keys, taxmap, &ref_fp)){
+    fprintf(stderr,"Test topology fingerprint: error - The ref tree has unknown taxa\n");
+    return(EXIT_FAILURE);
+  }
+  free_tree(tree);
+  for(t=0; t<5; t++){
+    tree = parse_nh_string(tree_strings[t]);
+    tree_topology_fingerprint(tree, keys, taxmap, &fp);
+    if(fingerprint_equals(fp, ref_fp) != same[t]){
+      fprintf(stderr,"Test topology fingerprint: error - Tree %d should %shave the topology of the ref tree\n",t,(same[t] ? "" : "not "));
+      return(EXIT_FAILURE);
+    }
+    free_tree(tree);
+  }
+  tree = parse_nh_string("((a:1,b:1):1,c:1,(d:1,x:1):1);");
+  if(tree_topology_fingerprint(tree, keys, taxmap, &fp)){
+    fprintf(stderr,"Test topology fingerprint: error - Unknown taxon not detected\n");
+    return(EXIT_FAILURE);
+  }
+  free_tree(tree);
+  free_taxid_hashmap(taxmap);
+  free_fingerprint_keys(keys);
+  free_tree(ref_tree);
+  fprintf(stderr,"Test topology fingerprint: OK\n");
+  return(EXIT_SUCCESS);
+}
+
+/**
+   We test the majority-rule and extended majority consensus trees of 4 trees.
+   Split counts: ef:3, cdef:2, def:2, cef:2, bdef:1, de:1, bcef:1
+   Majority : only ef (0.75)
+   Extended : ef, then 2 of the compatible splits of count 2 : fully resolved
+ */
+int test_consensus(){
+  char *boot_tree_strings[4] = {"((a:1,b:1):1,c:1,(d:1,(e:1,f:1):1):1);",
+				"((a:1,b:1):1,d:1,(c:1,(e:1,f:1):1):1);",
+				"((a:1,c:1):1,b:1,(f:1,(d:1,e:1):1):1);",
+				"((a:1,d:1):1,b:1,(c:1,(e:1,f:1):1):1);"};
+  char** taxname_lookup_table = NULL;
+  Tree *boot_tree, *consensus;
+  split_table *st = NULL;
+  int t, i, type, nb_internal;
+  int expected_internal[2] = {1, 3};
+
+  for(t=0; t<4; t++){
+    boot_tree = complete_parse_nh(boot_tree_strings[t], &taxname_lookup_table);
+    if(st == NULL) st = new_split_table(boot_tree->nb_taxa, 2, 1);
+    split_table_add_tree(st, boot_tree, t);
+    free_tree(boot_tree);
+  }
+
+  for(type = CONSENSUS_MAJORITY; type <= CONSENSUS_EXTENDED; type++){
+    consensus = consensus_tree(st, type, &taxname_lookup_table);
+    nb_internal = 0;
+    for(i=0; i<consensus->nb_edges; i++){
+      if(consensus->a_edges[i]->right->nneigh == 1) continue;
+      nb_internal++;
+      if(consensus->a_edges[i]->hashtbl[1]->num_items == 2 && consensus->a_edges[i]->branch_support != 0.75){
+	fprintf(stderr,"Test consensus: error - support of the split ef is %f and should be 0.75\n",consensus->a_edges[i]->branch_support);
+	return(EXIT_FAILURE);
+      }
+    }
+    if(nb_internal != expected_internal[type]){
+      fprintf(stderr,"Test consensus: error - the consensus (type %d) has %d internal branches and should have %d\n",type,nb_internal,expected_internal[type]);
+      write_nh_tree(consensus, stderr);
+      return(EXIT_FAILURE);
+    }
+    free_tree(consensus);
+  }
+  free_split_table(st);
+
+  /* rooted trees: the split abc|def of the two root edges has the sum of their lengths */
+  st = NULL;
+  for(t=0; t<2; t++){
+    boot_tree = complete_parse_nh((t == 0 ? "(((a:1,b:1):1,c:1):0.5,(d:1,(e:1,f:1):1):0.25);" : "(((a:1,b:1):1,c:1):1,d:1,(e:1,f:1):1);"), &taxname_lookup_table);
+    if(st == NULL) st = new_split_table(boot_tree->nb_taxa, 2, 1);
+    split_table_add_tree(st, boot_tree, t);
+    free_tree(boot_tree);
+  }
+  consensus = consensus_tree(st, CONSENSUS_MAJORITY, &taxname_lookup_table);
+  for(i=0; i<consensus->nb_edges; i++){
+    if(consensus->a_edges[i]->hashtbl[1]->num_items == 3 && consensus->a_edges[i]->brlen != 0.875){
+      fprintf(stderr,"Test consensus: error - length of the split abc|def is %f and should be 0.875\n",consensus->a_edges[i]->brlen);
+      return(EXIT_FAILURE);
+    }
+  }
+  free_tree(consensus);
+  free_split_table(st);
+  fprintf(stderr,"Test consensus: OK\n");
+  return(EXIT_SUCCESS);
+}
+
+/* Options of tbe() in the tests: quiet, cutoff of 0.3, no output file */
+tbe_options test_tbe_options(){
+  tbe_options opt = {.stat_file = NULL, .hist_file = NULL, .count_file = NULL, .dist_cutoff = 0.3, .quiet = 1,
+		     .kernel = TBE_KERNEL_AUTO, .batch = 1};
+  return opt;
+}
+
+/**
+   Histograms of the transfer distances (--hist), on 3 bootstrap trees with distances computed by hand:
+   ab and ef (depth 2) are at distance 0, 0 and 1 (normalized 1: last bucket), def (depth 3) at distance 
+   0, 1 (normalized 0.5: bucket ]0.4,0.5]) and 0. The binary output has the same counts as the text one.
+ */
+int test_histograms(){
+  char *ref_tree_string = "((a:1,b:1):1,c:1,(d:1,(e:1,f:1):1):1);";
+  char *boot_tree_strings[3] = {"((a:1,b:1):1,c:1,(d:1,(e:1,f:1):1):1);",
+				"((a:1,b:1):1,d:1,(c:1,(e:1,f:1):1):1);",
+				"((a:1,c:1):1,b:1,(f:1,(d:1,e:1):1):1);"};
+  char** taxname_lookup_table = NULL;
+  Tree *ref_tree = complete_parse_nh(ref_tree_string, &taxname_lookup_table);
+  FILE *tsv = tmpfile(), *bin = tmpfile();
+  int i, b, id, depth, nb_lines = 0;
+  long count, expected;
+  int32_t header[2];
+  int64_t counts[HIST_BUCKETS+1];
+  char magic[4], line[1024];
+  tbe_options opt = test_tbe_options();
+
+  opt.hist_file = tsv;
+  tbe(&ref_tree, 1, NULL, NULL, boot_tree_strings, taxname_lookup_table, 3, &opt, NULL);
+  opt.hist_file = bin;
+  opt.hist_binary = 1;
+  tbe(&ref_tree, 1, NULL, NULL, boot_tree_strings, taxname_lookup_table, 3, &opt, NULL);
+  rewind(tsv);
+  rewind(bin);
+  if(fgets(line, sizeof(line), tsv) == NULL || fread(magic, 1, 4, bin) != 4 || memcmp(magic, HIST_MAGIC, 4)
+     || fread(header, sizeof(int32_t), 2, bin) != 2 || header[0] != 3 || header[1] != HIST_BUCKETS+1){
+    fprintf(stderr,"Test histograms: error - wrong headers\n");
+    return(EXIT_FAILURE);
+  }
+  while(fscanf(tsv, "%d\t%d", &id, &depth) == 2){
+    nb_lines++;
+    if(fread(header, sizeof(int32_t), 2, bin) != 2 || fread(counts, sizeof(int64_t), HIST_BUCKETS+1, bin) != HIST_BUCKETS+1
+       || header[0] != id || header[1] != depth || depth != ref_tree->a_edges[id]->topo_depth){
+      fprintf(stderr,"Test histograms: error - binary record of branch %d differs\n", id);
+      return(EXIT_FAILURE);
+    }
+    for(b=0; b<=HIST_BUCKETS; b++){
+      if(fscanf(tsv, "%ld", &count) != 1) count = -1;
+      expected = (b == 0 ? 2 : ((depth == 2 && b == HIST_BUCKETS) || (depth == 3 && b == 5) ? 1 : 0));
+      if(count != expected || counts[b] != expected){
+	fprintf(stderr,"Test histograms: error - branch %d (depth %d) has %ld / %ld trees in bucket %d instead of %ld\n", id, depth, count, (long)counts[b], b, expected);
+	return(EXIT_FAILURE);
+      }
+    }
+  }
+  if(nb_lines != 3){
+    fprintf(stderr,"Test histograms: error - %d branches instead of 3\n", nb_lines);
+    return(EXIT_FAILURE);
+  }
+  fclose(tsv);
+  fclose(bin);
+  free_tree(ref_tree);
+  for(i=0; i<6; i++) free(taxname_lookup_table[i]);
+  free(taxname_lookup_table);
+  fprintf(stderr,"Test histograms: OK\n");
+  return(EXIT_SUCCESS);
+}
+
+/**
+   -a tbe,fbp: the FBP counts taken by tbe() are those of fbp() (each internal branch is in 2 of the 3 trees), 
+   the mean distances those computed by hand (1/3 for each branch), and the TBE supports are not changed.
+ */
+int test_tbe_fbp(){
+  char *ref_tree_string = "((a:1,b:1):1,c:1,(d:1,(e:1,f:1):1):1);";
+  char *boot_tree_strings[3] = {"((a:1,b:1):1,c:1,(d:1,(e:1,f:1):1):1);",
+				"((a:1,b:1):1,d:1,(c:1,(e:1,f:1):1):1);",
+				"((a:1,c:1):1,b:1,(f:1,(d:1,e:1):1):1);"};
+  char** taxname_lookup_table = NULL;
+  Tree *ref_tree = complete_parse_nh(ref_tree_string, &taxname_lookup_table);
+  Tree *tbe_tree = complete_parse_nh(ref_tree_string, &taxname_lookup_table);
+  Tree *fbp_tree = complete_parse_nh(ref_tree_string, &taxname_lookup_table);
+  int i, *nb_found = calloc(ref_tree->nb_edges, sizeof(int));
+  double *mean_dist = calloc(ref_tree->nb_edges, sizeof(double));
+  tbe_options opt = test_tbe_options();
+
+  tbe(&ref_tree, 1, &mean_dist, &nb_found, boot_tree_strings, taxname_lookup_table, 3, &opt, NULL);
+  tbe(&tbe_tree, 1, NULL, NULL, boot_tree_strings, taxname_lookup_table, 3, &opt, NULL);
+  fbp(&fbp_tree, 1, boot_tree_strings, taxname_lookup_table, 3, 1, 0, NULL);
+  for(i=0; i<ref_tree->nb_edges; i++){
+    if(ref_tree->a_edges[i]->right->nneigh == 1) continue;
+    if(nb_found[i] != 2 || nb_found[i] * 1.0 / 3 != fbp_tree->a_edges[i]->branch_support){
+      fprintf(stderr,"Test tbe,fbp: error - branch %d is found %d times with tbe, and has a fbp support of %f\n", i, nb_found[i], fbp_tree->a_edges[i]->branch_support);
+      return(EXIT_FAILURE);
+    }
+    if(fabs(mean_dist[i] - 1.0/3) > 1e-9 || ref_tree->a_edges[i]->branch_support != tbe_tree->a_edges[i]->branch_support){
+      fprintf(stderr,"Test tbe,fbp: error - branch %d has a mean distance of %f (instead of 1/3) and a tbe support of %f instead of %f\n", i, mean_dist[i], ref_tree->a_edges[i]->branch_support, tbe_tree->a_edges[i]->branch_support);
+      return(EXIT_FAILURE);
+    }
+  }
+  free(nb_found);
+  free(mean_dist);
+  free_tree(ref_tree);
+  free_tree(tbe_tree);
+  free_tree(fbp_tree);
+  for(i=0; i<6; i++) free(taxname_lookup_table[i]);
+  free(taxname_lookup_table);
+  fprintf(stderr,"Test tbe,fbp: OK\n");
+  return(EXIT_SUCCESS);
+}
+
+/* Reads the whole file (rewound) into a new string */
+char* test_read_file(FILE *f){
+  long size;
+  char *s;
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  rewind(f);
+  s = calloc(size+1, sizeof(char));
+  if(fread(s, 1, size, f) != size) s[0] = '\0';
+  return s;
+}
+
+/**
+   Transfer index in the stat file, with a cutoff of 0.5 (only def, of depth 3, can be close): def is at distance 0 in 
+   the first tree, 1 in the second (e moves) and 2 in the third, that has no close branch and is left out of the 
+   mean: e moves around 1 of the close branches of 1 of the 2 other trees (50%). With the third tree only, NA.
+ */
+int test_transfer_index(){
+  char *ref_tree_string = "((a:1,b:1):1,c:1,(d:1,(e:1,f:1):1):1);";
+  char *boot_tree_strings[3] = {"((a:1,b:1):1,c:1,(d:1,(e:1,f:1):1):1);",
+				"((a:1,e:1):1,c:1,(b:1,(d:1,f:1):1):1);",
+				"((a:1,d:1):1,e:1,(b:1,(c:1,f:1):1):1);"};
+  char** taxname_lookup_table = NULL;
+  Tree *ref_tree = complete_parse_nh(ref_tree_string, &taxname_lookup_table);
+  FILE *stat;
+  int i, nb_trees;
+  char *content, *taxa, expected[16], line[64];
+  tbe_options opt = test_tbe_options();
+
+  for(nb_trees=1; nb_trees<=3; nb_trees+=2){
+    opt.stat_file = stat = tmpfile();
+    opt.dist_cutoff = 0.5;
+    /* the third tree alone, or the three trees */
+    tbe(&ref_tree, 1, NULL, NULL, boot_tree_strings + 3 - nb_trees, taxname_lookup_table, nb_trees, &opt, NULL);
+    content = test_read_file(stat);
+    taxa = strstr(content, "Taxon\ttIndex\n");
+    for(i=0; i<6; i++){
+      if(nb_trees == 1) sprintf(expected, "NA");
+      else sprintf(expected, "%f", (!strcmp(taxname_lookup_table[i], "e") ? 50.0 : 0.0));
+      sprintf(line, "\n%s\t%s\n", taxname_lookup_table[i], expected);
+      if(taxa == NULL || strstr(taxa, line) == NULL){
+	fprintf(stderr,"Test transfer index: error - %d trees, the tIndex of %s is not %s\n", nb_trees, taxname_lookup_table[i], expected);
+	return(EXIT_FAILURE);
+      }
+    }
+    free(content);
+    fclose(stat);
+  }
+  free_tree(ref_tree);
+  for(i=0; i<6; i++) free(taxname_lookup_table[i]);
+  free(taxname_lookup_table);
+  fprintf(stderr,"Test transfer index: OK\n");
+  return(EXIT_SUCCESS);
+}
+
+/**
+   Several reference trees in one run: the supports (tbe with the raw distances, the fbp counts and the 
+   stat file, and fbp) are those of separate runs on each reference tree, the stat file being the 
+   concatenation of their stat files.
+ */
+int test_multiple_references(){
+  char *ref_tree_strings[3] = {"((a:1,b:1):1,c:1,(d:1,(e:1,f:1):1):1);",
+			       "((a:1,c:1):1,b:1,(f:1,(d:1,e:1):1):1);",
+			       "(((a:1,d:1):1,b:1):1,(c:1,(e:1,f:1):1):1);"};
+  char *boot_tree_strings[4] = {"((a:1,b:1):1,c:1,(d:1,(e:1,f:1):1):1);",
+				"((a:1,b:1):1,d:1,(c:1,(e:1,f:1):1):1);",
+				"((a:1,c:1):1,b:1,(f:1,(d:1,e:1):1):1);",
+				"((a:1,d:1):1,b:1,(c:1,(e:1,f:1):1):1);"};
+  char** taxname_lookup_table = NULL;
+  Tree *refs[3], *single[3];
+  FILE *stat = tmpfile(), *single_stat = tmpfile();
+  double *mean_dist[3], *single_dist;
+  int *nb_found[3], *single_found;
+  int r, i, algo;
+  char *all, *separate;
+  tbe_options opt = test_tbe_options();
+
+  for(algo=0; algo<2; algo++){
+    for(r=0; r<3; r++){
+      refs[r] = complete_parse_nh(ref_tree_strings[r], &taxname_lookup_table);
+      mean_dist[r] = calloc(refs[r]->nb_edges, sizeof(double));
+      nb_found[r] = calloc(refs[r]->nb_edges, sizeof(int));
+    }
+    /* 0: tbe,fbp with the raw distances and a stat file, 1: fbp */
+    opt.stat_file = stat;
+    opt.count_per_branch = 1;
+    if(algo == 0) tbe(refs, 3, mean_dist, nb_found, boot_tree_strings, taxname_lookup_table, 4, &opt, NULL);
+    else fbp(refs, 3, boot_tree_strings, taxname_lookup_table, 4, 1, 0, NULL);
+    for(r=0; r<3; r++){
+      single[r] = complete_parse_nh(ref_tree_strings[r], &taxname_lookup_table);
+      single_dist = calloc(single[r]->nb_edges, sizeof(double));
+      single_found = calloc(single[r]->nb_edges, sizeof(int));
+      opt.stat_file = single_stat;
+      if(algo == 0) tbe(&single[r], 1, &single_dist, &single_found, boot_tree_strings, taxname_lookup_table, 4, &opt, NULL);
+      else fbp(&single[r], 1, boot_tree_strings, taxname_lookup_table, 4, 1, 0, NULL);
+      for(i=0; i<refs[r]->nb_edges; i++){
+	if(refs[r]->a_edges[i]->right->nneigh == 1) continue;
+	if(refs[r]->a_edges[i]->branch_support != single[r]->a_edges[i]->branch_support
+	   || mean_dist[r][i] != single_dist[i] || nb_found[r][i] != single_found[i]){
+	  fprintf(stderr,"Test multiple references: error - branch %d of reference %d (algo %d): support %f, distance %f, found %d instead of %f, %f, %d\n",
+		  i, r, algo, refs[r]->a_edges[i]->branch_support, mean_dist[r][i], nb_found[r][i],
+		  single[r]->a_edges[i]->branch_support, single_dist[i], single_found[i]);
+	  return(EXIT_FAILURE);
+	}
+      }
+      free(single_dist);
+      free(single_found);
+      free_tree(single[r]);
+    }
+    for(r=0; r<3; r++){
+      free(mean_dist[r]);
+      free(nb_found[r]);
+      free_tree(refs[r]);
+    }
+  }
+
+  all = test_read_file(stat);
+  separate = test_read_file(single_stat);
+  if(strlen(all) == 0 || strcmp(all, separate)){
+    fprintf(stderr,"Test multiple references: error - the stat file differs from the ones of separate runs\n");
+    return(EXIT_FAILURE);
+  }
+  free(all);
+  free(separate);
+  fclose(stat);
+  fclose(single_stat);
+  for(i=0; i<6; i++) free(taxname_lookup_table[i]);
+  free(taxname_lookup_table);
+  fprintf(stderr,"Test multiple references: OK\n");
+  return(EXIT_SUCCESS);
+}
+
 int main(int arbc, char** argv){
   srand(time(NULL)); /* seeding the random generator */
   
@@ -1447,6 +2270,46 @@ int main(int arbc, char** argv){
     return(exit_code);
   }
 
+  exit_code = test_split_table();
+  if(exit_code != EXIT_SUCCESS){
+    return(exit_code);
+  }
+
+  exit_code = test_thread_accumulator();
+  if(exit_code != EXIT_SUCCESS){
+    return(exit_code);
+  }
+
+  exit_code = test_topology_fingerprint();
+  if(exit_code != EXIT_SUCCESS){
+    return(exit_code);
+  }
+
+  exit_code = test_consensus();
+  if(exit_code != EXIT_SUCCESS){
+    return(exit_code);
+  }
+
+  exit_code = test_histograms();
+  if(exit_code != EXIT_SUCCESS){
+    return(exit_code);
+  }
+
+  exit_code = test_tbe_fbp();
+  if(exit_code != EXIT_SUCCESS){
+    return(exit_code);
+  }
+
+  exit_code = test_multiple_references();
+  if(exit_code != EXIT_SUCCESS){
+    return(exit_code);
+  }
+
+  exit_code = test_transfer_index();
+  if(exit_code != EXIT_SUCCESS){
+    return(exit_code);
+  }
+
   exit_code = test_transfer_1();
   if(exit_code != EXIT_SUCCESS){
     return(exit_code);
@@ -1466,6 +2329,31 @@ int main(int arbc, char** argv){
   if(exit_code != EXIT_SUCCESS){
     return(exit_code);
   }
+
+  exit_code = test_transfer_random();
+  if(exit_code != EXIT_SUCCESS){
+    return(exit_code);
+  }
+
+  exit_code = test_transfer_batch();
+  if(exit_code != EXIT_SUCCESS){
+    return(exit_code);
+  }
+
+  exit_code = test_transfer_cache();
+  if(exit_code != EXIT_SUCCESS){
+    return(exit_code);
+  }
+
+  exit_code = test_transfer_simd();
+  if(exit_code != EXIT_SUCCESS){
+    return(exit_code);
+  }
+
+  exit_code = test_transfer_large();
+  if(exit_code != EXIT_SUCCESS){
+    return(exit_code);
+  }
   
   return(exit_code);
 }
@@ -0,0 +1,996 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "transfer.h"
+
+#define CACHE_SEED_LO 0x2545f4914f6cdd1dULL
+#define CACHE_SEED_HI 0x9e3779b97f4a7c15ULL
+
+static short unsigned* get_column(tbe_workspace *ws){
+  if(ws->nb_free == 0){
+    /* cannot happen with the heavy first traversal */
+    fprintf(stderr,"No more free column in the workspace. Aborting.\n");
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+  if(ws->nb_columns - ws->nb_free + 1 > ws->max_live) ws->max_live = ws->nb_columns - ws->nb_free + 1;
+  return ws->free_columns[--ws->nb_free];
+}
+
+static void release_column(tbe_workspace *ws, short unsigned *column){
+  ws->free_columns[ws->nb_free++] = column;
+}
+
+/* numbers the internal edges of the ref tree (of depth at least min_depth) in post-order */
+static void ref_post_order(ref_index *ref, Node *orig, Node *target, int min_depth){
+  int j, n = target->nneigh;
+  int target_to_orig = dir_a_to_b(target, orig);
+  Edge *my_br = orig->br[dir_a_to_b(orig, target)];
+  for(j=1; j<n; j++) ref_post_order(ref, target, target->neigh[(target_to_orig + j) % n], min_depth);
+  if(n > 1 && my_br->topo_depth >= min_depth){
+    ref->items[ref->nb_internal] = my_br->hashtbl[1]->num_items;
+    ref->internal[ref->nb_internal++] = my_br->id;
+  }
+}
+
+/* depth first order of the taxa: the clade of each internal edge is contiguous */
+static void ref_leaf_order(ref_index *ref, const int *edge_index, Node *orig, Node *target, int *next){
+  int j, n = target->nneigh, first = *next;
+  int target_to_orig = dir_a_to_b(target, orig);
+  Edge *my_br = orig->br[dir_a_to_b(orig, target)];
+  if(n == 1){
+    ref->leaf_order[*next] = ref->leaf_taxon[my_br->id];
+    ref->taxon_rank[ref->leaf_taxon[my_br->id]] = (*next)++;
+  }
+  for(j=1; j<n; j++) ref_leaf_order(ref, edge_index, target, target->neigh[(target_to_orig + j) % n], next);
+  if(n > 1 && edge_index[my_br->id] != -1){
+    ref->clade_first[edge_index[my_br->id]] = first;
+    ref->clade_span[edge_index[my_br->id]] = *next - 1 - first;
+  }
+}
+
+static ref_index* new_ref_index_depth(Tree *ref_tree, int min_depth){
+  int i, k, next = 0, m = ref_tree->nb_edges, n = ref_tree->nb_taxa, *edge_index;
+  Node *root = ref_tree->node0;
+  Edge *re;
+  ref_index *ref = malloc(sizeof(ref_index));
+  ref->tree = ref_tree;
+  ref->nb_taxa = n;
+  ref->nb_edges = m;
+  ref->internal = malloc(m * sizeof(int));
+  ref->items = aligned_malloc(m * sizeof(short unsigned), 0);
+  ref->leaf_taxon = malloc(m * sizeof(int));
+  ref->topo_depth = malloc(m * sizeof(int));
+  ref->denom = malloc(m * sizeof(double));
+
+  for(i=0; i<m; i++){
+    re = ref_tree->a_edges[i];
+    ref->topo_depth[i] = re->topo_depth;
+    ref->denom[i] = ((double)re->topo_depth) - 1.0;
+    ref->leaf_taxon[i] = (re->right->nneigh == 1 ? first_id(re->hashtbl[1]) : -1);
+  }
+  ref->nb_internal = 0;
+  for(i=0; i<root->nneigh; i++) ref_post_order(ref, root, root->neigh[i], min_depth);
+
+  ref->nb_chunks = (n + 8*sizeof(unsigned long) - 1) / (8*sizeof(unsigned long));
+  ref->clades = NULL;
+  ref->keys = NULL;
+  ref->clade_fp = NULL;
+  edge_index = malloc(m * sizeof(int));
+  for(i=0; i<m; i++) edge_index[i] = -1;
+  for(k=0; k<ref->nb_internal; k++) edge_index[ref->internal[k]] = k;
+  ref->taxon_rank = malloc(n * sizeof(int));
+  ref->leaf_order = malloc(n * sizeof(int));
+  ref->clade_first = aligned_malloc(m * sizeof(short unsigned), 0);
+  ref->clade_span = aligned_malloc(m * sizeof(short unsigned), 0);
+  for(i=0; i<n; i++) ref->taxon_rank[i] = -1;
+  for(i=0; i<root->nneigh; i++) ref_leaf_order(ref, edge_index, root, root->neigh[i], &next);
+  /* the taxon of the root, if it is a leaf, is in no clade */
+  for(i=0; i<n; i++){
+    if(ref->taxon_rank[i] == -1){
+      ref->leaf_order[next] = i;
+      ref->taxon_rank[i] = next++;
+    }
+  }
+  free(edge_index);
+  ref->nb_steps = 0;
+  ref->steps = NULL;
+  ref->sparse_max_depth = 0;
+  ref->shallow = NULL;
+  ref->nb_shallow = 0;
+  ref->deep = NULL;
+  ref->nb_parts = 0;
+  ref->parts = NULL;
+  return ref;
+}
+
+ref_index* new_ref_index(Tree *ref_tree){
+  return new_ref_index_depth(ref_tree, 0);
+}
+
+void ref_index_add_fingerprints(ref_index *ref){
+  int k;
+  fingerprint_t *edge_fp;
+  if(ref->clade_fp != NULL) return;
+  ref->keys = new_fingerprint_keys(ref->nb_taxa, FINGERPRINT_SEED);
+  edge_fp = malloc(ref->nb_edges * sizeof(fingerprint_t));
+  tree_edge_fingerprints(ref->tree, ref->keys, edge_fp);
+  ref->clade_fp = malloc(ref->nb_internal * sizeof(fingerprint_t));
+  for(k=0; k<ref->nb_internal; k++) ref->clade_fp[k] = edge_fp[ref->internal[k]];
+  free(edge_fp);
+}
+
+void ref_index_add_clades(ref_index *ref){
+  int k;
+  if(ref->clades != NULL) return;
+  ref->clades = aligned_malloc(((size_t)ref->nb_internal) * ref->nb_chunks * sizeof(unsigned long), 0);
+  for(k=0; k<ref->nb_internal; k++){
+    memcpy(ref->clades + ((size_t)k) * ref->nb_chunks, ref->tree->a_edges[ref->internal[k]]->hashtbl[1]->bitarray,
+	   ref->nb_chunks * sizeof(unsigned long));
+  }
+  ref_index_add_fingerprints(ref);
+}
+
+static void push_step(ref_index *ref, int *capacity, int arg, int type){
+  if(ref->nb_steps == *capacity){
+    *capacity *= 2;
+    ref->steps = realloc(ref->steps, *capacity * sizeof(int));
+  }
+  ref->steps[ref->nb_steps++] = (arg << 2) | type;
+}
+
+/* adds (or removes) all the taxa below the edge orig->target */
+static void push_clade_steps(ref_index *ref, int *capacity, Node *orig, Node *target, int type){
+  int j, n = target->nneigh;
+  int target_to_orig = dir_a_to_b(target, orig);
+  if(n == 1) push_step(ref, capacity, ref->leaf_taxon[orig->br[dir_a_to_b(orig, target)]->id], type);
+  for(j=1; j<n; j++) push_clade_steps(ref, capacity, target, target->neigh[(target_to_orig + j) % n], type);
+}
+
+/* small to large: the light children are done (and cleared) first, then the heavy child, whose taxa are
+   kept, then the taxa of the light children are added again. The clade is then complete and queried,
+   and cleared if it is itself a light child */
+static void ref_steps_post_order(ref_index *ref, int *capacity, const int *edge_index, Node *orig, Node *target, int keep){
+  int j, dir, heavy = -1, n = target->nneigh;
+  int target_to_orig = dir_a_to_b(target, orig);
+  Edge *my_br = orig->br[dir_a_to_b(orig, target)];
+
+  if(n == 1){
+    push_step(ref, capacity, ref->leaf_taxon[my_br->id], TBE_STEP_ADD);
+    if(!keep) push_step(ref, capacity, ref->leaf_taxon[my_br->id], TBE_STEP_REMOVE);
+    return;
+  }
+  for(j=1; j<n; j++){
+    dir = (target_to_orig + j) % n;
+    if(heavy == -1 || target->br[dir]->hashtbl[1]->num_items > target->br[heavy]->hashtbl[1]->num_items) heavy = dir;
+  }
+  for(j=1; j<n; j++){
+    dir = (target_to_orig + j) % n;
+    if(dir != heavy) ref_steps_post_order(ref, capacity, edge_index, target, target->neigh[dir], 0);
+  }
+  ref_steps_post_order(ref, capacity, edge_index, target, target->neigh[heavy], 1);
+  for(j=1; j<n; j++){
+    dir = (target_to_orig + j) % n;
+    if(dir != heavy) push_clade_steps(ref, capacity, target, target->neigh[dir], TBE_STEP_ADD);
+  }
+  push_step(ref, capacity, edge_index[my_br->id], TBE_STEP_QUERY);
+  if(!keep) push_clade_steps(ref, capacity, orig, target, TBE_STEP_REMOVE);
+}
+
+void ref_index_add_steps(ref_index *ref){
+  int i, k, capacity = 4 * ref->nb_taxa + 16;
+  int *edge_index;
+  Node *root = ref->tree->node0;
+  if(ref->steps != NULL) return;
+  edge_index = malloc(ref->nb_edges * sizeof(int));
+  for(k=0; k<ref->nb_internal; k++) edge_index[ref->internal[k]] = k;
+  ref->steps = malloc(capacity * sizeof(int));
+  for(i=0; i<root->nneigh; i++) ref_steps_post_order(ref, &capacity, edge_index, root, root->neigh[i], 0);
+  free(edge_index);
+}
+
+void ref_index_add_sparse(ref_index *ref, int max_depth){
+  int k;
+  if(ref->deep != NULL) return;
+  /* the complement of the boot clades can only be close to the ref clades on the heavy path from the root
+     if the ref clades have at most n/4 taxa */
+  if(max_depth > ref->nb_taxa / 4) max_depth = ref->nb_taxa / 4;
+  ref->sparse_max_depth = max_depth;
+  ref->shallow = malloc(ref->nb_internal * sizeof(int));
+  for(k=0; k<ref->nb_internal; k++){
+    if(ref->topo_depth[ref->internal[k]] <= max_depth) ref->shallow[ref->nb_shallow++] = k;
+  }
+  ref->deep = new_ref_index_depth(ref->tree, max_depth + 1);
+}
+
+void ref_index_add_parts(ref_index *ref, int nb_parts){
+  int t, first, block;
+  const int line = WORKSPACE_ALIGN / sizeof(short unsigned);
+  if(ref->parts != NULL) return;
+  if(nb_parts < 1) nb_parts = 1;
+  block = (ref->nb_internal + nb_parts - 1) / nb_parts;
+  block = ((block + line - 1) / line) * line;
+  if(block == 0) block = line;
+  /* at least one part, that also gives the terminal edges */
+  ref->nb_parts = (ref->nb_internal + block - 1) / block;
+  if(ref->nb_parts == 0) ref->nb_parts = 1;
+  ref->parts = malloc(ref->nb_parts * sizeof(ref_index));
+  for(t=0; t<ref->nb_parts; t++){
+    first = t * block;
+    ref->parts[t] = *ref;
+    ref->parts[t].nb_internal = (first + block <= ref->nb_internal ? block : ref->nb_internal - first);
+    ref->parts[t].internal = ref->internal + first;
+    ref->parts[t].items = ref->items + first;
+    ref->parts[t].clade_first = ref->clade_first + first;
+    ref->parts[t].clade_span = ref->clade_span + first;
+    ref->parts[t].clades = NULL;
+    ref->parts[t].clade_fp = NULL;
+    ref->parts[t].steps = NULL;
+    ref->parts[t].shallow = NULL;
+    ref->parts[t].deep = NULL;
+    ref->parts[t].nb_parts = 0;
+    ref->parts[t].parts = NULL;
+  }
+}
+
+void free_ref_index(ref_index *ref){
+  free(ref->internal);
+  aligned_free(ref->items);
+  free(ref->leaf_taxon);
+  free(ref->topo_depth);
+  free(ref->denom);
+  free(ref->taxon_rank);
+  free(ref->leaf_order);
+  aligned_free(ref->clade_first);
+  aligned_free(ref->clade_span);
+  free(ref->steps);
+  free(ref->shallow);
+  if(ref->deep != NULL) free_ref_index(ref->deep);
+  /* the parts only share the arrays of the index */
+  free(ref->parts);
+  if(ref->clades != NULL) aligned_free(ref->clades);
+  if(ref->clade_fp != NULL){
+    free_fingerprint_keys(ref->keys);
+    free(ref->clade_fp);
+  }
+  free(ref);
+}
+
+void ref_leaf_column_range(const ref_index *ref, int taxon, int first, int length, short unsigned *column){
+  tbe_interval_to_column(length, ref->clade_first + first, ref->clade_span + first, ref->taxon_rank[taxon], column);
+}
+
+void ref_leaf_column(const ref_index *ref, int taxon, short unsigned *column){
+  ref_leaf_column_range(ref, taxon, 0, ref->nb_internal, column);
+}
+
+/* standard post-order (the one of update_all_i_post_order_boot_tree): numbers the edges and counts the taxa below them */
+static int columns_rank_post_order(tbe_workspace *ws, Node *orig, Node *target, int *next_rank){
+  int j, n = target->nneigh, card = 0;
+  int target_to_orig = dir_a_to_b(target, orig);
+  Edge *my_br = orig->br[dir_a_to_b(orig, target)];
+  if(n == 1) card = 1;
+  for(j=1; j<n; j++) card += columns_rank_post_order(ws, target, target->neigh[(target_to_orig + j) % n], next_rank);
+  ws->card[my_br->id] = card;
+  ws->rank_edge[*next_rank] = my_br->id;
+  ws->rank[my_br->id] = (*next_rank)++;
+  return card;
+}
+
+/* common subtree below a boot edge, in the ref tree reduced to the clades without exact match: the intersection 
+   with the reduced ref clades is the size of the subtree or 0 (meta-leaf). The inner edges of the subtree are 
+   farther than the edge itself or its terminal edges, that are all at the same distance: the one of smallest rank */
+static short unsigned* contract_meta_leaf(const ref_index *ref, tbe_workspace *ws, int edge_id){
+  int i, k, r, leaf_rank = -1, card = ws->card[edge_id];
+  short unsigned *column = get_column(ws);
+  for(i=ws->meta_first[edge_id]; i<=ws->meta_first[edge_id]+ws->meta_span[edge_id]; i++){
+    r = ws->rank[ws->boot_leaf_edge[ref->leaf_order[i]]];
+    if(leaf_rank == -1 || r < leaf_rank) leaf_rank = r;
+  }
+  ref_leaf_column(ref, ref->leaf_order[ws->meta_first[edge_id]], column);
+  tbe_column_min_keys(ref->nb_internal, ref->items, column, 1, ref->nb_taxa, leaf_rank, ws->min_key);
+  for(k=0; k<ref->nb_internal; k++) column[k] *= card;
+  tbe_column_min_keys(ref->nb_internal, ref->items, column, card, ref->nb_taxa, ws->rank[edge_id], ws->min_key);
+  return column;
+}
+
+static short unsigned* columns_post_order(const ref_index *ref, tbe_workspace *ws, Node *orig, Node *target);
+
+/* column of the edge orig->target, computed from the columns of its children */
+static short unsigned* columns_subtree(const ref_index *ref, tbe_workspace *ws, Node *orig, Node *target){
+  int j, dir, heavy = -1, n = target->nneigh;
+  int target_to_orig = dir_a_to_b(target, orig);
+  Edge *my_br = orig->br[dir_a_to_b(orig, target)];
+  int edge_id = my_br->id;
+  short unsigned *column, *child_column;
+
+  if(ws->meta_span != NULL && ws->meta_span[edge_id] != -1) return contract_meta_leaf(ref, ws, edge_id);
+  if(n == 1){
+    /* terminal edge: the intersection with a ref clade is 1 iff the ref clade contains the taxon */
+    int taxon = first_id(my_br->hashtbl[1]);
+    ws->boot_leaf_edge[taxon] = edge_id;
+    column = get_column(ws);
+    ref_leaf_column(ref, taxon, column);
+  } else {
+    /* the heaviest child first: its column becomes ours */
+    for(j=1; j<n; j++){
+      dir = (target_to_orig + j) % n;
+      if(heavy == -1 || ws->card[target->br[dir]->id] > ws->card[target->br[heavy]->id]) heavy = dir;
+    }
+    column = columns_post_order(ref, ws, target, target->neigh[heavy]);
+    for(j=1; j<n; j++){
+      dir = (target_to_orig + j) % n;
+      if(dir == heavy) continue;
+      child_column = columns_post_order(ref, ws, target, target->neigh[dir]);
+      tbe_column_add(ref->nb_internal, column, child_column);
+      release_column(ws, child_column);
+    }
+  }
+  tbe_column_min_keys(ref->nb_internal, ref->items, column, ws->card[edge_id], ref->nb_taxa, ws->rank[edge_id] - ws->key_base, ws->key_target);
+  return column;
+}
+
+/* subtree of the column cache: looked up, and if it is not found and not inside a subtree being stored,
+   computed with the keys of its edges apart, and stored */
+static short unsigned* cached_subtree(const ref_index *ref, tbe_workspace *ws, Node *orig, Node *target, int edge_id){
+  int k, base = ws->rank[edge_id] - ws->subtree_edges[edge_id] + 1;
+  fingerprint_t fp = ws->subtree_fp[edge_id];
+  short unsigned *column = get_column(ws);
+
+  if(column_cache_get(ws->cache, fp, column, ws->key_target, base - ws->key_base)) return column;
+  release_column(ws, column);
+  if(ws->key_target != ws->min_key) return columns_subtree(ref, ws, orig, target);
+
+  for(k=0; k<ref->nb_internal; k++) ws->record_keys[k] = UINT32_MAX;
+  ws->key_target = ws->record_keys;
+  ws->key_base = base;
+  column = columns_subtree(ref, ws, orig, target);
+  column_cache_put(ws->cache, fp, column, ws->record_keys);
+  for(k=0; k<ref->nb_internal; k++){
+    if(ws->record_keys[k] + base < ws->min_key[k]) ws->min_key[k] = ws->record_keys[k] + base;
+  }
+  ws->key_target = ws->min_key;
+  ws->key_base = 0;
+  return column;
+}
+
+/* returns the column of the edge orig->target, to be released by the caller */
+static short unsigned* columns_post_order(const ref_index *ref, tbe_workspace *ws, Node *orig, Node *target){
+  int edge_id = orig->br[dir_a_to_b(orig, target)]->id;
+  if(ws->cache != NULL && ws->card[edge_id] >= TBE_CACHE_MIN_CARD && ws->card[edge_id] <= TBE_CACHE_MAX_CARD){
+    return cached_subtree(ref, ws, orig, target, edge_id);
+  }
+  return columns_subtree(ref, ws, orig, target);
+}
+
+static inline uint64_t cache_mix(uint64_t h){
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  return h ^ (h >> 31);
+}
+
+/* fingerprint of the subtree below each edge, depending on the order of the children (that of the ranks),
+   and its number of edges */
+static fingerprint_t cache_subtree_post_order(const ref_index *ref, tbe_workspace *ws, Node *orig, Node *target){
+  int j, n = target->nneigh, nb_edges = 1;
+  int target_to_orig = dir_a_to_b(target, orig);
+  Edge *my_br = orig->br[dir_a_to_b(orig, target)];
+  fingerprint_t fp, child;
+  if(n == 1){
+    fp = ref->keys->keys[first_id(my_br->hashtbl[1])];
+  } else {
+    fp.lo = CACHE_SEED_LO;
+    fp.hi = CACHE_SEED_HI;
+    for(j=1; j<n; j++){
+      child = cache_subtree_post_order(ref, ws, target, target->neigh[(target_to_orig + j) % n]);
+      nb_edges += ws->subtree_edges[target->br[(target_to_orig + j) % n]->id];
+      fp.lo = cache_mix(fp.lo ^ child.lo);
+      fp.hi = cache_mix(fp.hi + child.hi);
+    }
+  }
+  ws->subtree_fp[my_br->id] = fp;
+  ws->subtree_edges[my_br->id] = nb_edges;
+  return fp;
+}
+
+/* column of each boot edge kept in the I matrix, edges visited in the standard post-order. Returns the card */
+static int dense_post_order(const ref_index *ref, tbe_workspace *ws, Node *orig, Node *target, int *next_rank){
+  int j, dir, n = target->nneigh, card = 0;
+  int target_to_orig = dir_a_to_b(target, orig);
+  Edge *my_br = orig->br[dir_a_to_b(orig, target)];
+  short unsigned *column = tbe_dense_column(ws, my_br->id);
+
+  if(n == 1){
+    int taxon = first_id(my_br->hashtbl[1]);
+    ws->boot_leaf_edge[taxon] = my_br->id;
+    ref_leaf_column(ref, taxon, column);
+    card = 1;
+  } else {
+    memset(column, 0, ref->nb_internal * sizeof(short unsigned));
+    for(j=1; j<n; j++){
+      dir = (target_to_orig + j) % n;
+      card += dense_post_order(ref, ws, target, target->neigh[dir], next_rank);
+      tbe_column_add(ref->nb_internal, column, tbe_dense_column(ws, target->br[dir]->id));
+    }
+  }
+  ws->rank_edge[*next_rank] = my_br->id;
+  tbe_column_min_keys(ref->nb_internal, ref->items, column, card, ref->nb_taxa, (*next_rank)++, ws->min_key);
+  return card;
+}
+
+static void init_min_keys(const ref_index *ref, tbe_workspace *ws){
+  int k;
+  for(k=0; k<ref->nb_internal; k++) ws->min_key[k] = UINT32_MAX;
+}
+
+/* min distances and edges from the keys, and terminal edges of the ref tree: always at distance 0 of 
+   the terminal boot edge of their taxon */
+static void scatter_min_distances(const ref_index *ref, tbe_workspace *ws){
+  int i, k;
+  for(k=0; k<ref->nb_internal; k++){
+    i = ref->internal[k];
+    ws->min_dist[i] = ws->min_key[k] >> TBE_RANK_BITS;
+    ws->min_dist_edge[i] = ws->rank_edge[ws->min_key[k] & ((1U << TBE_RANK_BITS) - 1)];
+  }
+  for(i=0; i<ref->nb_edges; i++){
+    if(ref->leaf_taxon[i] == -1) continue;
+    ws->min_dist[i] = 0;
+    ws->min_dist_edge[i] = ws->boot_leaf_edge[ref->leaf_taxon[i]];
+  }
+}
+
+void min_transfer_distances_columns(const ref_index *ref, Tree *boot_tree, tbe_workspace *ws){
+  int i, next_rank = 0, n = boot_tree->node0->nneigh;
+  Node *root = boot_tree->node0;
+
+  init_min_keys(ref, ws);
+  for(i=0; i<n; i++) columns_rank_post_order(ws, root, root->neigh[i], &next_rank);
+  if(ws->cache != NULL){
+    /* the leaves of the subtrees found in the cache are not visited */
+    for(i=0; i<n; i++) cache_subtree_post_order(ref, ws, root, root->neigh[i]);
+    taxon_terminal_edges(boot_tree, ws->boot_leaf_edge);
+  }
+  for(i=0; i<n; i++) release_column(ws, columns_post_order(ref, ws, root, root->neigh[i]));
+  scatter_min_distances(ref, ws);
+}
+
+void min_transfer_distances_dense(const ref_index *ref, Tree *boot_tree, tbe_workspace *ws){
+  int i, next_rank = 0, n = boot_tree->node0->nneigh;
+  Node *root = boot_tree->node0;
+
+  init_min_keys(ref, ws);
+  for(i=0; i<n; i++) dense_post_order(ref, ws, root, root->neigh[i], &next_rank);
+  scatter_min_distances(ref, ws);
+}
+
+static uint32_t popcount_key(const ref_index *ref, const unsigned long *a, const unsigned long *b, int rank){
+  int w, dist = 0;
+  for(w=0; w<ref->nb_chunks; w++) dist += __builtin_popcountl(a[w] ^ b[w]);
+  if(dist > ref->nb_taxa/2) dist = ref->nb_taxa - dist;
+  return (((uint32_t)dist) << TBE_RANK_BITS) | rank;
+}
+
+/* 
+   Min keys of all the internal ref clades against the boot clades of ranks first..last-1, whose bitsets 
+   (a tile small enough to stay in cache) are compared to each ref clade in turn. The transfer distance between 
+   clades of a and b taxa is at least min(|a-b|, |n-a-b|): pairs whose bound cannot beat the current min are skipped.
+*/
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(__clang__)
+__attribute__((target_clones("popcnt","default")))
+#endif
+static void popcount_tile(const ref_index *ref, tbe_workspace *ws, int first, int last){
+  int j, k, w, nb_chunks = ref->nb_chunks, N = ref->nb_taxa, half = N/2;
+  for(k=0; k<ref->nb_internal; k++){
+    const unsigned long *a = ref->clades + ((size_t)k) * nb_chunks;
+    int items = ref->items[k];
+    uint32_t best = ws->min_key[k];
+    /* exact match found by fingerprint: nothing can beat it */
+    if((best >> TBE_RANK_BITS) == 0) continue;
+    for(j=first; j<last; j++){
+      const unsigned long *b = ws->boot_bits + ((size_t)j) * nb_chunks;
+      int card = ws->rank_card[j];
+      int bound = abs(items - card), bound2 = abs(N - items - card), dist = 0;
+      uint32_t key;
+      if(bound2 < bound) bound = bound2;
+      if(((((uint32_t)bound) << TBE_RANK_BITS) | j) >= best) continue;
+      for(w=0; w<nb_chunks; w++) dist += __builtin_popcountl(a[w] ^ b[w]);
+      if(dist > half) dist = N - dist;
+      key = (((uint32_t)dist) << TBE_RANK_BITS) | j;
+      if(key < best) best = key;
+    }
+    ws->min_key[k] = best;
+  }
+}
+
+/* the keys start from the boot clade with the same canonical fingerprint (smallest rank), if any: 
+   with their actual distance, so that a collision of fingerprints gives a valid (but not 0) starting point */
+static void popcount_exact_matches(const ref_index *ref, Tree *boot_tree, tbe_workspace *ws, int nb_ranks){
+  int k, r, slot;
+  fingerprint_t fp;
+  tree_edge_fingerprints(boot_tree, ref->keys, ws->boot_fp);
+  memset(ws->fp_slots, 0, (ws->fp_mask + 1) * sizeof(int));
+  for(r=0; r<nb_ranks; r++){
+    fp = ws->boot_fp[ws->rank_edge[r]];
+    for(slot = fp.lo & ws->fp_mask; ws->fp_slots[slot] != 0; slot = (slot + 1) & ws->fp_mask){
+      if(fingerprint_equals(ws->boot_fp[ws->rank_edge[ws->fp_slots[slot]-1]], fp)) break;
+    }
+    if(ws->fp_slots[slot] == 0) ws->fp_slots[slot] = r + 1;
+  }
+  for(k=0; k<ref->nb_internal; k++){
+    fp = ref->clade_fp[k];
+    for(slot = fp.lo & ws->fp_mask; ws->fp_slots[slot] != 0; slot = (slot + 1) & ws->fp_mask){
+      r = ws->fp_slots[slot] - 1;
+      if(fingerprint_equals(ws->boot_fp[ws->rank_edge[r]], fp)){
+	ws->min_key[k] = popcount_key(ref, ref->clades + ((size_t)k) * ref->nb_chunks, ws->boot_bits + ((size_t)r) * ws->nb_chunks, r);
+	break;
+      }
+    }
+  }
+}
+
+void min_transfer_distances_popcount(const ref_index *ref, Tree *boot_tree, tbe_workspace *ws){
+  int i, r, tile, next_rank = 0, n = boot_tree->node0->nneigh;
+  Node *root = boot_tree->node0;
+  Edge *be;
+
+  if(ref->clades == NULL){
+    fprintf(stderr,"The clades of the ref index are needed by the popcount kernel. Aborting.\n");
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+  init_min_keys(ref, ws);
+  for(i=0; i<n; i++) columns_rank_post_order(ws, root, root->neigh[i], &next_rank);
+  /* boot bitsets in rank order, so that the pairs are compared in the order of the other kernels */
+  for(r=0; r<next_rank; r++){
+    be = boot_tree->a_edges[ws->rank_edge[r]];
+    memcpy(ws->boot_bits + ((size_t)r) * ws->nb_chunks, be->hashtbl[1]->bitarray, ws->nb_chunks * sizeof(unsigned long));
+    ws->rank_card[r] = ws->card[be->id];
+  }
+  taxon_terminal_edges(boot_tree, ws->boot_leaf_edge);
+  popcount_exact_matches(ref, boot_tree, ws, next_rank);
+
+  tile = POPCOUNT_TILE_BYTES / (ws->nb_chunks * sizeof(unsigned long));
+  if(tile < 1) tile = 1;
+  for(r=0; r<next_rank; r+=tile) popcount_tile(ref, ws, r, (r + tile < next_rank ? r + tile : next_rank));
+  scatter_min_distances(ref, ws);
+}
+
+/* boot edge of smallest rank with the same bipartition as each internal ref edge, and whether the clade and
+   all the ref clades below it are in the boot tree, the clade being also the one below the boot edge */
+static void contract_exact_matches(const ref_index *ref, Tree *boot_tree, tbe_workspace *ws, int nb_ranks){
+  int k, r, slot, top = 0, *stack = ws->kept;
+  fingerprint_t fp;
+  Edge *re, *be;
+  tree_edge_fingerprints(boot_tree, ref->keys, ws->boot_fp);
+  memset(ws->fp_slots, 0, (ws->fp_mask + 1) * sizeof(int));
+  for(r=0; r<nb_ranks; r++){
+    fp = ws->boot_fp[ws->rank_edge[r]];
+    for(slot = fp.lo & ws->fp_mask; ws->fp_slots[slot] != 0; slot = (slot + 1) & ws->fp_mask){
+      if(fingerprint_equals(ws->boot_fp[ws->rank_edge[ws->fp_slots[slot]-1]], fp)) break;
+    }
+    if(ws->fp_slots[slot] == 0) ws->fp_slots[slot] = r + 1;
+  }
+  for(r=0; r<nb_ranks; r++) ws->meta_span[ws->rank_edge[r]] = -1;
+  for(k=0; k<ref->nb_internal; k++){
+    re = ref->tree->a_edges[ref->internal[k]];
+    fp = ref->clade_fp[k];
+    ws->match[k] = -1;
+    ws->shared[k] = 0;
+    for(slot = fp.lo & ws->fp_mask; ws->fp_slots[slot] != 0; slot = (slot + 1) & ws->fp_mask){
+      be = boot_tree->a_edges[ws->rank_edge[ws->fp_slots[slot]-1]];
+      if(!fingerprint_equals(ws->boot_fp[be->id], fp)) continue;
+      /* the fingerprints only give candidates */
+      if(equal_id_hashtables(re->hashtbl[1], be->hashtbl[1])){
+	ws->match[k] = be->id;
+	ws->shared[k] = 1;
+      } else if(complement_id_hashtables(re->hashtbl[1], be->hashtbl[1], ref->nb_taxa)){
+	ws->match[k] = be->id;
+      }
+      break;
+    }
+    /* the internal ref edges below k are the top of the stack (post-order), with the ranks of their taxa after clade_first[k] */
+    while(top > 0 && ref->clade_first[stack[top-1]] >= ref->clade_first[k]){
+      top--;
+      if(!ws->shared[stack[top]]) ws->shared[k] = 0;
+    }
+    stack[top++] = k;
+    if(ws->shared[k]){
+      ws->meta_first[ws->match[k]] = ref->clade_first[k];
+      ws->meta_span[ws->match[k]] = ref->clade_span[k];
+    }
+  }
+}
+
+void min_transfer_distances_contract(const ref_index *ref, Tree *boot_tree, tbe_workspace *ws){
+  int i, k, next_rank = 0, n = boot_tree->node0->nneigh;
+  Node *root = boot_tree->node0;
+  ref_index reduced;
+
+  if(ref->clade_fp == NULL){
+    fprintf(stderr,"The fingerprints of the ref index are needed by the contract kernel. Aborting.\n");
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+  for(i=0; i<n; i++) columns_rank_post_order(ws, root, root->neigh[i], &next_rank);
+  taxon_terminal_edges(boot_tree, ws->boot_leaf_edge);
+  contract_exact_matches(ref, boot_tree, ws, next_rank);
+
+  /* the ref tree without the clades that are in the boot tree */
+  reduced = *ref;
+  reduced.nb_internal = 0;
+  reduced.internal = ws->kept;
+  reduced.items = ws->kept_items;
+  reduced.clade_first = ws->kept_first;
+  reduced.clade_span = ws->kept_span;
+  for(k=0; k<ref->nb_internal; k++){
+    if(ws->match[k] != -1) continue;
+    ws->kept[reduced.nb_internal] = ref->internal[k];
+    ws->kept_items[reduced.nb_internal] = ref->items[k];
+    ws->kept_first[reduced.nb_internal] = ref->clade_first[k];
+    ws->kept_span[reduced.nb_internal++] = ref->clade_span[k];
+  }
+  init_min_keys(&reduced, ws);
+  if(reduced.nb_internal > 0){
+    for(i=0; i<n; i++) release_column(ws, columns_post_order(&reduced, ws, root, root->neigh[i]));
+  }
+  scatter_min_distances(&reduced, ws);
+  for(k=0; k<ref->nb_internal; k++){
+    if(ws->match[k] == -1) continue;
+    ws->min_dist[ref->internal[k]] = 0;
+    ws->min_dist_edge[ref->internal[k]] = ws->match[k];
+  }
+}
+
+void tbe_workspace_add_parts(tbe_workspace *ws, const ref_index *ref, int huge_pages){
+  int t;
+  if(ws->parts != NULL) return;
+  ws->kernel = TBE_KERNEL_ROWS;
+  ws->nb_parts = ref->nb_parts;
+  ws->parts = malloc(ref->nb_parts * sizeof(tbe_workspace*));
+  for(t=0; t<ref->nb_parts; t++){
+    ws->parts[t] = new_tbe_workspace(ws->nb_taxa, ws->nb_edges_ref, ref->parts[t].nb_internal, TBE_KERNEL_COLUMNS, huge_pages);
+  }
+}
+
+void min_transfer_distances_rows(const ref_index *ref, Tree *boot_tree, tbe_workspace *ws){
+  int t, k, i;
+#pragma omp parallel for private(t) shared(ref, boot_tree, ws) schedule(static, 1)
+  for(t=0; t<ref->nb_parts; t++) min_transfer_distances_columns(ref->parts + t, boot_tree, ws->parts[t]);
+  for(t=0; t<ref->nb_parts; t++){
+    for(k=0; k<ref->parts[t].nb_internal; k++){
+      i = ref->parts[t].internal[k];
+      ws->min_dist[i] = ws->parts[t]->min_dist[i];
+      ws->min_dist_edge[i] = ws->parts[t]->min_dist_edge[i];
+    }
+  }
+  for(i=0; i<ref->nb_edges; i++){
+    if(ref->leaf_taxon[i] == -1) continue;
+    ws->min_dist[i] = 0;
+    ws->min_dist_edge[i] = ws->parts[0]->min_dist_edge[i];
+  }
+}
+
+void min_transfer_distances(const ref_index *ref, Tree *boot_tree, tbe_workspace *ws){
+  switch(ws->kernel){
+  case TBE_KERNEL_DENSE: min_transfer_distances_dense(ref, boot_tree, ws); break;
+  case TBE_KERNEL_COLUMNS: min_transfer_distances_columns(ref, boot_tree, ws); break;
+  case TBE_KERNEL_POPCOUNT: min_transfer_distances_popcount(ref, boot_tree, ws); break;
+  case TBE_KERNEL_FAST: min_transfer_distances_fast(ref, boot_tree, ws); break;
+  case TBE_KERNEL_SPARSE: min_transfer_distances_sparse(ref, boot_tree, ws); break;
+  case TBE_KERNEL_CONTRACT: min_transfer_distances_contract(ref, boot_tree, ws); break;
+  case TBE_KERNEL_ROWS: min_transfer_distances_rows(ref, boot_tree, ws); break;
+  default:
+    fprintf(stderr,"Unknown tbe kernel %d. Aborting.\n", ws->kernel);
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+}
+
+/* instructions of the batch programs, followed by 2 operands */
+#define BATCH_LEAF 0 /* taxon: push its leaf column */
+#define BATCH_ADD  1 /* pop the top column and add it to the new top */
+#define BATCH_MIN  2 /* card, rank: min keys of the top column */
+#define BATCH_POP  3
+
+static void batch_emit(tbe_workspace *ws, int op, int a, int b){
+  ws->program[ws->program_length++] = op;
+  ws->program[ws->program_length++] = a;
+  ws->program[ws->program_length++] = b;
+}
+
+/* same traversal as columns_post_order */
+static void batch_compile_post_order(tbe_workspace *ws, Node *orig, Node *target){
+  int j, dir, heavy = -1, n = target->nneigh;
+  int target_to_orig = dir_a_to_b(target, orig);
+  Edge *my_br = orig->br[dir_a_to_b(orig, target)];
+
+  if(n == 1){
+    int taxon = first_id(my_br->hashtbl[1]);
+    ws->boot_leaf_edge[taxon] = my_br->id;
+    batch_emit(ws, BATCH_LEAF, taxon, 0);
+  } else {
+    for(j=1; j<n; j++){
+      dir = (target_to_orig + j) % n;
+      if(heavy == -1 || ws->card[target->br[dir]->id] > ws->card[target->br[heavy]->id]) heavy = dir;
+    }
+    batch_compile_post_order(ws, target, target->neigh[heavy]);
+    for(j=1; j<n; j++){
+      dir = (target_to_orig + j) % n;
+      if(dir == heavy) continue;
+      batch_compile_post_order(ws, target, target->neigh[dir]);
+      batch_emit(ws, BATCH_ADD, 0, 0);
+    }
+  }
+  batch_emit(ws, BATCH_MIN, ws->card[my_br->id], ws->rank[my_br->id]);
+}
+
+void tbe_batch_compile(Tree *boot_tree, tbe_workspace *ws){
+  int i, next_rank = 0, n = boot_tree->node0->nneigh;
+  Node *root = boot_tree->node0;
+  for(i=0; i<n; i++) columns_rank_post_order(ws, root, root->neigh[i], &next_rank);
+  ws->program_length = 0;
+  for(i=0; i<n; i++){
+    batch_compile_post_order(ws, root, root->neigh[i]);
+    batch_emit(ws, BATCH_POP, 0, 0);
+  }
+}
+
+void min_transfer_distances_batch(const ref_index *ref, tbe_workspace **ws, int nb_trees){
+  int t, pc, first, length, top;
+  short unsigned *stack = ws[0]->col_block;
+  int *program;
+
+  for(t=0; t<nb_trees; t++) init_min_keys(ref, ws[t]);
+  for(first=0; first<ref->nb_internal; first+=TBE_BATCH_ROWS){
+    length = (first + TBE_BATCH_ROWS < ref->nb_internal ? TBE_BATCH_ROWS : ref->nb_internal - first);
+    for(t=0; t<nb_trees; t++){
+      program = ws[t]->program;
+      top = -1;
+      for(pc=0; pc<ws[t]->program_length; pc+=3){
+	switch(program[pc]){
+	case BATCH_LEAF:
+	  top++;
+	  ref_leaf_column_range(ref, program[pc+1], first, length, stack + top * TBE_BATCH_ROWS);
+	  break;
+	case BATCH_ADD:
+	  top--;
+	  tbe_column_add(length, stack + top * TBE_BATCH_ROWS, stack + (top+1) * TBE_BATCH_ROWS);
+	  break;
+	case BATCH_MIN:
+	  tbe_column_min_keys(length, ref->items + first, stack + top * TBE_BATCH_ROWS, program[pc+1], ref->nb_taxa,
+			      program[pc+2], ws[t]->min_key + first);
+	  break;
+	default:
+	  top--;
+	}
+      }
+    }
+  }
+  for(t=0; t<nb_trees; t++) scatter_min_distances(ref, ws[t]);
+}
+
+/* heavy path decomposition of the boot tree: position of each edge in the segment tree (the edges of
+   a heavy path are contiguous, from its top), top edge of its path, and parent edge (-1 below the root) */
+static void fast_decompose(tbe_workspace *ws, Node *orig, Node *target, int parent_edge, int head, int *next_pos){
+  int j, dir, heavy = -1, n = target->nneigh;
+  int target_to_orig = dir_a_to_b(target, orig);
+  int edge_id = orig->br[dir_a_to_b(orig, target)]->id;
+
+  ws->path_parent[edge_id] = parent_edge;
+  ws->path_head[edge_id] = (head == -1 ? edge_id : head);
+  ws->path_pos[edge_id] = (*next_pos)++;
+  if(n == 1){
+    ws->boot_leaf_edge[first_id(orig->br[dir_a_to_b(orig, target)]->hashtbl[1])] = edge_id;
+    return;
+  }
+  for(j=1; j<n; j++){
+    dir = (target_to_orig + j) % n;
+    if(heavy == -1 || ws->card[target->br[dir]->id] > ws->card[target->br[heavy]->id]) heavy = dir;
+  }
+  fast_decompose(ws, target, target->neigh[heavy], edge_id, ws->path_head[edge_id], next_pos);
+  for(j=1; j<n; j++){
+    dir = (target_to_orig + j) % n;
+    if(dir != heavy) fast_decompose(ws, target, target->neigh[dir], edge_id, -1, next_pos);
+  }
+}
+
+/* recomputes the ancestors of a leaf of the segment tree: own pending add + min/max of the children */
+static void segment_pull(tbe_workspace *ws, int i){
+  int64_t *mn = ws->seg_min, *mx = ws->seg_max;
+  for(i >>= 1; i >= 1; i >>= 1){
+    mn[i] = (mn[2*i] < mn[2*i+1] ? mn[2*i] : mn[2*i+1]) + ws->seg_add[i];
+    mx[i] = (mx[2*i] > mx[2*i+1] ? mx[2*i] : mx[2*i+1]) + ws->seg_add[i];
+  }
+}
+
+/* adds delta to the keys of the positions first..last */
+static void segment_add(tbe_workspace *ws, int first, int last, int64_t delta){
+  int lo = first + ws->seg_size, hi = last + ws->seg_size + 1;
+  int64_t *mn = ws->seg_min, *mx = ws->seg_max, *add = ws->seg_add;
+  for(; lo < hi; lo >>= 1, hi >>= 1){
+    if(lo & 1){ mn[lo] += delta; mx[lo] += delta; add[lo] += delta; lo++; }
+    if(hi & 1){ hi--; mn[hi] += delta; mx[hi] += delta; add[hi] += delta; }
+  }
+  segment_pull(ws, first + ws->seg_size);
+  segment_pull(ws, last + ws->seg_size);
+}
+
+/* adds delta to the keys of all the edges from the terminal edge of taxon to the root */
+static void fast_path_add(tbe_workspace *ws, int taxon, int64_t delta){
+  int edge_id = ws->boot_leaf_edge[taxon], head;
+  while(edge_id != -1){
+    head = ws->path_head[edge_id];
+    segment_add(ws, ws->path_pos[head], ws->path_pos[edge_id], delta);
+    edge_id = ws->path_parent[head];
+  }
+}
+
+void min_transfer_distances_fast(const ref_index *ref, Tree *boot_tree, tbe_workspace *ws){
+  int i, s, k, a, rank, rank2, next_rank = 0, next_pos = 0, n = boot_tree->node0->nneigh, nb_taxa = ref->nb_taxa;
+  const int64_t rank_mask = (1 << TBE_RANK_BITS) - 1;
+  const int64_t step = ((int64_t)2) << TBE_RANK_BITS;
+  int64_t d, d2, key_min, key_max;
+  Node *root = boot_tree->node0;
+
+  for(i=0; i<n; i++) columns_rank_post_order(ws, root, root->neigh[i], &next_rank);
+  for(i=0; i<n; i++) fast_decompose(ws, root, root->neigh[i], -1, -1, &next_pos);
+
+  /* empty ref clade: |B xor A| = |B| */
+  for(i=0; i<ws->seg_size; i++){
+    ws->seg_min[ws->seg_size + i] = INT64_MAX / 2;
+    ws->seg_max[ws->seg_size + i] = INT64_MIN / 2;
+  }
+  for(i=0; i<next_rank; i++){
+    d = ((int64_t)(ws->card[ws->rank_edge[i]] + nb_taxa)) << TBE_RANK_BITS;
+    ws->seg_min[ws->seg_size + ws->path_pos[ws->rank_edge[i]]] = d | i;
+    ws->seg_max[ws->seg_size + ws->path_pos[ws->rank_edge[i]]] = d | (rank_mask - i);
+  }
+  for(i=ws->seg_size-1; i>=1; i--){
+    ws->seg_add[i] = 0;
+    ws->seg_min[i] = (ws->seg_min[2*i] < ws->seg_min[2*i+1] ? ws->seg_min[2*i] : ws->seg_min[2*i+1]);
+    ws->seg_max[i] = (ws->seg_max[2*i] > ws->seg_max[2*i+1] ? ws->seg_max[2*i] : ws->seg_max[2*i+1]);
+  }
+
+  for(s=0; s<ref->nb_steps; s++){
+    switch(ref->steps[s] & 3){
+    case TBE_STEP_ADD: fast_path_add(ws, ref->steps[s] >> 2, -step); break;
+    case TBE_STEP_REMOVE: fast_path_add(ws, ref->steps[s] >> 2, step); break;
+    default:
+      /* |A xor B| min over the boot edges, and n - |A xor B| min, from the max */
+      k = ref->steps[s] >> 2;
+      a = ref->items[k];
+      key_min = ws->seg_min[1];
+      key_max = ws->seg_max[1];
+      /* both distances go up to n: they are compared unpacked, and only the smaller one (at most n/2) is packed */
+      d = (key_min >> TBE_RANK_BITS) - nb_taxa + a;
+      rank = key_min & rank_mask;
+      d2 = nb_taxa - ((key_max >> TBE_RANK_BITS) - nb_taxa + a);
+      rank2 = rank_mask - (key_max & rank_mask);
+      if(d2 < d || (d2 == d && rank2 < rank)){
+	d = d2;
+	rank = rank2;
+      }
+      ws->min_key[k] = (((uint32_t)d) << TBE_RANK_BITS) | (uint32_t)rank;
+    }
+  }
+  scatter_min_distances(ref, ws);
+}
+
+/* Euler tour of the boot tree: entry and exit times of the edges, parent edges and heaviest child edges */
+static void sparse_euler_tour(tbe_workspace *ws, Node *orig, Node *target, int parent_edge, int *time){
+  int j, dir, n = target->nneigh;
+  int target_to_orig = dir_a_to_b(target, orig);
+  Edge *my_br = orig->br[dir_a_to_b(orig, target)];
+  int edge_id = my_br->id, child;
+
+  ws->sparse_parent[edge_id] = parent_edge;
+  ws->sparse_heavy[edge_id] = -1;
+  ws->euler_in[edge_id] = (*time)++;
+  if(n == 1) ws->boot_leaf_edge[first_id(my_br->hashtbl[1])] = edge_id;
+  for(j=1; j<n; j++){
+    dir = (target_to_orig + j) % n;
+    child = target->br[dir]->id;
+    sparse_euler_tour(ws, target, target->neigh[dir], edge_id, time);
+    if(ws->sparse_heavy[edge_id] == -1 || ws->card[child] > ws->card[ws->sparse_heavy[edge_id]]) ws->sparse_heavy[edge_id] = child;
+  }
+  ws->euler_out[edge_id] = *time - 1;
+}
+
+static int compare_ints(const void *a, const void *b){
+  return (*(const int*)a > *(const int*)b) - (*(const int*)a < *(const int*)b);
+}
+
+/* number of sorted values in [low, high] */
+static int count_in_range(const int *values, int nb, int low, int high){
+  int lo = 0, hi = nb, mid, first;
+  while(lo < hi){ mid = (lo + hi) / 2; if(values[mid] < low) lo = mid + 1; else hi = mid; }
+  first = lo;
+  hi = nb;
+  while(lo < hi){ mid = (lo + hi) / 2; if(values[mid] <= high) lo = mid + 1; else hi = mid; }
+  return lo - first;
+}
+
+static inline uint32_t sparse_key(const tbe_workspace *ws, int edge_id, int d, int overlap){
+  int dist = d + ws->card[edge_id] - 2 * overlap;
+  if(dist > ws->nb_taxa - dist) dist = ws->nb_taxa - dist;
+  return (((uint32_t)dist) << TBE_RANK_BITS) | ws->rank[edge_id];
+}
+
+void min_transfer_distances_sparse(const ref_index *ref, Tree *boot_tree, tbe_workspace *ws){
+  int i, s, k, d, e, t, nb_side, nb_touched, time = 0, next_rank = 0, n = ref->nb_taxa;
+  int first, last, root_heavy = -1;
+  uint32_t key, key2;
+  Node *root = boot_tree->node0;
+
+  /* deep edges (and terminal edges) */
+  if(ref->deep->nb_internal > 0) min_transfer_distances_columns(ref->deep, boot_tree, ws);
+  else for(i=0; i<root->nneigh; i++) columns_rank_post_order(ws, root, root->neigh[i], &next_rank);
+  for(i=0; i<root->nneigh; i++){
+    sparse_euler_tour(ws, root, root->neigh[i], -1, &time);
+    e = root->br[i]->id;
+    if(root_heavy == -1 || ws->card[e] > ws->card[root_heavy]) root_heavy = e;
+  }
+  if(ref->deep->nb_internal == 0) scatter_min_distances(ref->deep, ws);
+
+  for(s=0; s<ref->nb_shallow; s++){
+    k = ref->shallow[s];
+    first = ref->clade_first[k];
+    last = first + ref->clade_span[k];
+    /* smaller side of the ref edge: its clade, or the taxa before and after it */
+    d = last - first + 1;
+    if(2*d <= n){
+      memcpy(ws->side, ref->leaf_order + first, d * sizeof(int));
+    } else {
+      d = n - d;
+      memcpy(ws->side, ref->leaf_order, first * sizeof(int));
+      memcpy(ws->side + first, ref->leaf_order + last + 1, (n - last - 1) * sizeof(int));
+    }
+    nb_side = d;
+    key = UINT32_MAX;
+
+    /* clades of less than 2d taxa above the taxa of S */
+    nb_touched = 0;
+    for(t=0; t<nb_side; t++){
+      for(e = ws->boot_leaf_edge[ws->side[t]]; e != -1 && ws->card[e] < 2*d; e = ws->sparse_parent[e]){
+	if(ws->overlap[e]++ == 0) ws->touched[nb_touched++] = e;
+      }
+    }
+    for(t=0; t<nb_touched; t++){
+      e = ws->touched[t];
+      key2 = sparse_key(ws, e, d, ws->overlap[e]);
+      if(key2 < key) key = key2;
+      ws->overlap[e] = 0;
+    }
+
+    /* clades of more than n-2d taxa: the heaviest path from the root */
+    if(root_heavy != -1 && ws->card[root_heavy] > n - 2*d){
+      for(t=0; t<nb_side; t++) ws->side[t] = ws->euler_in[ws->boot_leaf_edge[ws->side[t]]];
+      qsort(ws->side, nb_side, sizeof(int), compare_ints);
+      for(e = root_heavy; e != -1 && ws->card[e] > n - 2*d; e = ws->sparse_heavy[e]){
+	key2 = sparse_key(ws, e, d, count_in_range(ws->side, nb_side, ws->euler_in[e], ws->euler_out[e]));
+	if(key2 < key) key = key2;
+      }
+    }
+    i = ref->internal[k];
+    ws->min_dist[i] = key >> TBE_RANK_BITS;
+    ws->min_dist_edge[i] = ws->rank_edge[key & ((1U << TBE_RANK_BITS) - 1)];
+  }
+}
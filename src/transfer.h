@@ -0,0 +1,199 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _TRANSFER_H_
+#define _TRANSFER_H_
+
+#include <stdint.h>
+#include "tree.h"
+#include "workspace.h"
+#include "transfer_simd.h"
+#include "column_cache.h"
+
+/*
+  Transfer distances computed column by column.
+
+  The I matrix of the Brehelin/Gascuel/Martin algorithm has one row per internal edge of the reference 
+  tree and one column per edge of the bootstrap tree. In the post-order traversal of the bootstrap tree,
+  the column of an edge is the sum of the columns of its children. Columns are contiguous (the rows being
+  the internal ref edges in post-order, with their metadata in the arrays of the ref index), so that the 
+  sums and the distance computations are unit stride loops that the compiler vectorizes.
+
+  The dense kernel keeps the column of every bootstrap edge. The column kernel takes them from a pool 
+  and gives them back as soon as they have been added to their parent's column: visiting the heaviest 
+  child first (and adopting its column as the parent's column) bounds the number of live columns
+  by log2(n)+1, whatever the shape of the bootstrap tree.
+
+  The minimum distance of each reference edge is the same as with update_all_i_post_order_*_tree, and 
+  so is the edge achieving it: ties are broken on the rank of the bootstrap edges in the standard 
+  post-order traversal. Distances and ranks are packed in a single key (dist << TBE_RANK_BITS | rank) 
+  so that this is a plain min.
+*/
+
+/* dense I matrices bigger than this are replaced by the column kernel in tbe() */
+#define TBE_DENSE_MAX_BYTES (1UL << 30)
+/* branches of depth up to nb_taxa / TBE_SPARSE_DEPTH_RATIO go through the sparse kernel in tbe() */
+#define TBE_SPARSE_DEPTH_RATIO 64
+/* bootstrap subtrees looked up in the column cache: smaller ones are cheaper to compute than to look up */
+#define TBE_CACHE_MIN_CARD 16
+#define TBE_CACHE_MAX_CARD 256
+/* min number of rows of each thread for the rows kernel to be chosen */
+#define TBE_ROWS_MIN_PART 256
+/* size of the tiles of boot bitsets of the popcount kernel (in L1 cache) */
+#define POPCOUNT_TILE_BYTES (16*1024)
+/*
+  Everything the kernels need to know about the reference tree, computed once and shared
+  (read only) by all the threads. The internal edges are numbered 0..nb_internal-1 in 
+  post-order: the columns of the column kernel are indexed this way.
+  The taxa are also ranked in the depth first order of the ref tree, so that each clade is an 
+  interval of ranks: two integers per edge instead of a bitset, and the leaf column of a taxon
+  (is it in the clade of each internal edge?) is a vectorized interval test.
+*/
+typedef struct ref_index{
+  Tree *tree;
+  int nb_taxa;
+  int nb_edges;
+  int nb_internal;
+  int *internal;         /* edge id of each internal edge */
+  short unsigned *items; /* number of taxa in the clade (hashtbl[1]) of each internal edge */
+  int *leaf_taxon;       /* by edge id: taxon of a terminal edge, -1 for internal edges */
+  int *topo_depth;       /* by edge id */
+  double *denom;         /* by edge id: topo_depth - 1, denominator of the normalized transfer distance */
+  int *taxon_rank;       /* rank of each taxon in the depth first order */
+  int *leaf_order;       /* taxon of each rank */
+  /* the clade of internal edge k is leaf_order[clade_first[k]..clade_first[k]+clade_span[k]] */
+  short unsigned *clade_first;
+  short unsigned *clade_span;
+  /* bitsets (hashtbl[1]) of the internal edges copied in a single block, for the popcount kernel. 
+     NULL until ref_index_add_clades (the fingerprints are also set by ref_index_add_fingerprints) */
+  int nb_chunks;         /* unsigned long per bitset */
+  unsigned long *clades;
+  fingerprint_keys *keys;
+  fingerprint_t *clade_fp; /* canonical fingerprint of each internal edge */
+  /* fast kernel: taxa added to / removed from the current ref clade, and queries of the internal edges
+     (TBE_STEP_*), in the order of a small to large traversal of the ref tree. NULL until ref_index_add_steps */
+  int nb_steps;
+  int *steps;
+  /* sparse kernel (ref_index_add_sparse): the shallow internal edges, and the index of the deep ones,
+     whose distances are computed by the column kernel */
+  int sparse_max_depth;
+  int nb_shallow;
+  int *shallow;
+  struct ref_index *deep;
+  /* rows kernel (ref_index_add_parts): blocks of consecutive internal edges, each a ref index sharing
+     the arrays of this one */
+  int nb_parts;
+  struct ref_index *parts;
+} ref_index;
+
+/* steps of the fast kernel: (taxon or internal edge index) << 2 | type */
+#define TBE_STEP_ADD    0
+#define TBE_STEP_REMOVE 1
+#define TBE_STEP_QUERY  2
+
+ref_index* new_ref_index(Tree *ref_tree);
+void ref_index_add_clades(ref_index *ref);
+// Canonical fingerprints of the clades only (keys and clade_fp), without the bitsets
+void ref_index_add_fingerprints(ref_index *ref);
+void ref_index_add_steps(ref_index *ref);
+// Internal edges of depth at most max_depth (and at most n/4) are shallow for the sparse kernel
+void ref_index_add_sparse(ref_index *ref, int max_depth);
+// Splits the internal edges in at most nb_parts blocks of whole cache lines, for the rows kernel
+void ref_index_add_parts(ref_index *ref, int nb_parts);
+void free_ref_index(ref_index *ref);
+// Fills column[k], for all internal edges k, with 1 if taxon is in clade k, 0 otherwise
+void ref_leaf_column(const ref_index *ref, int taxon, short unsigned *column);
+// Same for the internal edges first..first+length-1 only, in column[0..length-1]
+void ref_leaf_column_range(const ref_index *ref, int taxon, int first, int length, short unsigned *column);
+
+// Computes, for each edge of the reference tree, its min transfer distance to boot_tree (ws->min_dist) 
+// and the bootstrap edge achieving it (ws->min_dist_edge), with the columns of the workspace.
+// With a column cache (tbe_workspace_add_cache, after ref_index_add_fingerprints), the subtrees of
+// TBE_CACHE_MIN_CARD to TBE_CACHE_MAX_CARD taxa found in the cache are not traversed
+void min_transfer_distances_columns(const ref_index *ref, Tree *boot_tree, tbe_workspace *ws);
+// Same with the I matrix of the workspace, whose leaf columns are taken from the ref index
+void min_transfer_distances_dense(const ref_index *ref, Tree *boot_tree, tbe_workspace *ws);
+// Same without I matrix: the distance of each pair of clades is the popcount of the xor of their bitsets
+// (after ref_index_add_clades). The exact matches are found first by fingerprint, and the pairs that 
+// cannot improve the min are skipped
+void min_transfer_distances_popcount(const ref_index *ref, Tree *boot_tree, tbe_workspace *ws);
+/*
+  Fast kernel, in O(n log^3(n)) per bootstrap tree instead of O(n^2). 
+  For a ref clade A of a taxa, and a boot edge b of clade B, |A xor B| = a + |B| - 2|A inter B|.
+  The boot tree is split in heavy paths, laid out contiguously in a segment tree whose leaves are
+  the boot edges, with the key ((|B| - 2|A inter B| + n) << TBE_RANK_BITS | rank) (and the same 
+  with the reversed rank, for the max). Adding a taxon to A is a -2 on the path from its leaf to 
+  the root: one range add, in O(log(n)), on each of the O(log(n)) heavy paths. The ref clades are 
+  built in the order of ref_index_add_steps (each taxon is added O(log(n)) times, hence the 
+  O(n log^3(n))), and the min transfer distance of a clade, with the same tie break on the ranks 
+  as the other kernels, is read from the min and the max of the whole tree.
+*/
+void min_transfer_distances_fast(const ref_index *ref, Tree *boot_tree, tbe_workspace *ws);
+/*
+  Sparse kernel, for the shallow ref edges: let S be the smaller side of the ref edge, of d taxa. 
+  Its min transfer distance is at most d-1 (terminal edge of any taxon of S), and a side X of a boot 
+  edge is at distance |S xor X| < d iff more than half of X is in S. Either X is the clade B of the
+  boot edge, |B| < 2d and B contains taxa of S: B is met walking up from the leaves of S until the 
+  clades reach 2d taxa, counting the taxa of S below each edge on the way. Or X is the complement 
+  of B, |B| > n-2d >= n/2: the edge is on the path of the heaviest children from the root, and the 
+  taxa of S below it are counted with the Euler tour of the boot tree (entry times of the leaves of
+  S in [entry, exit] of the edge). Only these candidates are compared: O(d log(d) + d.h) per ref edge. 
+  The deep edges are computed by the column kernel on the ref index ref->deep.
+*/
+void min_transfer_distances_sparse(const ref_index *ref, Tree *boot_tree, tbe_workspace *ws);
+/*
+  Contract kernel: the ref clades that are in the boot tree (found by fingerprint, and checked) are at
+  distance 0 of their boot edge, and are removed from the ref tree. A common subtree (a clade of both trees,
+  whose ref clades are all in the boot tree) becomes a meta-leaf of the boot tree, weighted by its number of
+  taxa: each reduced ref clade contains it or is disjoint from it. Only two of its edges can achieve 
+  a min distance, the edge above it and its terminal edges, so the columns of its inner edges are not 
+  computed. The column kernel is run on the reduced trees, and the results are those of the column kernel.
+*/
+void min_transfer_distances_contract(const ref_index *ref, Tree *boot_tree, tbe_workspace *ws);
+/*
+  Rows kernel, for the parallelism inside a bootstrap tree: the rows of the column kernel (ref->parts, 
+  after ref_index_add_parts) are computed in parallel by the threads of the OpenMP team, each block with 
+  its own workspace, for the whole bootstrap tree. The results are those of the column kernel.
+*/
+// Allocates the workspaces of the blocks of rows in ws (TBE_KERNEL_ROWS)
+void tbe_workspace_add_parts(tbe_workspace *ws, const ref_index *ref, int huge_pages);
+void min_transfer_distances_rows(const ref_index *ref, Tree *boot_tree, tbe_workspace *ws);
+// Calls the kernel of the workspace (not TBE_KERNEL_BATCH)
+void min_transfer_distances(const ref_index *ref, Tree *boot_tree, tbe_workspace *ws);
+
+/*
+  Batch kernel: the heavy first traversal of each bootstrap tree is compiled into a program 
+  (push the leaf column of a taxon, add the top column to the one below, min keys of the top column, pop),
+  and the programs of several trees are run on the same tile of TBE_BATCH_ROWS ref rows before going 
+  to the next tile. The ref data of a tile (clade intervals and sizes) is thus loaded once for all
+  the trees of the batch, and the stack of short columns stays in L1, whatever the size of the trees.
+  The results are those of the column kernel.
+*/
+// Compiles boot_tree into the program of the workspace (TBE_KERNEL_BATCH)
+void tbe_batch_compile(Tree *boot_tree, tbe_workspace *ws);
+// Min transfer distances of nb_trees compiled bootstrap trees, one workspace each
+void min_transfer_distances_batch(const ref_index *ref, tbe_workspace **ws, int nb_trees);
+
+#endif
@@ -0,0 +1,217 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "transfer_simd.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define TBE_SIMD_X86
+#include <immintrin.h>
+#endif
+
+static void column_add_scalar(int nb, short unsigned *column, const short unsigned *child_column){
+  int k;
+  for(k=0; k<nb; k++) column[k] += child_column[k];
+}
+
+static void interval_to_column_scalar(int nb, const short unsigned *first, const short unsigned *span, int rank, short unsigned *column){
+  int k;
+  /* rank - first[k] wraps around when rank < first[k] */
+  for(k=0; k<nb; k++) column[k] = ((short unsigned)(rank - first[k]) <= span[k]);
+}
+
+static void column_min_keys_scalar(int nb, const short unsigned *items, const short unsigned *column, int card,
+				   int nb_taxa, uint32_t rank, uint32_t *min_key){
+  int k, half = nb_taxa/2;
+  for(k=0; k<nb; k++){
+    int dist = items[k] + card - 2 * column[k];
+    uint32_t key;
+    dist = (dist > half ? nb_taxa - dist : dist);
+    key = (((uint32_t)dist) << TBE_RANK_BITS) | rank;
+    min_key[k] = (key < min_key[k] ? key : min_key[k]);
+  }
+}
+
+#ifdef TBE_SIMD_X86
+
+/* 
+   In 16-bit lanes, items + card - 2*column is computed modulo 65536, which gives the exact distance 
+   since it is between 0 and nb_taxa < 65536. The unsigned comparison dist > half is max(dist,half+1) == dist.
+*/
+__attribute__((target("avx2")))
+static void column_add_avx2(int nb, short unsigned *column, const short unsigned *child_column){
+  int k;
+  for(k=0; k+16<=nb; k+=16){
+    __m256i c = _mm256_loadu_si256((const __m256i*)(column+k));
+    __m256i d = _mm256_loadu_si256((const __m256i*)(child_column+k));
+    _mm256_storeu_si256((__m256i*)(column+k), _mm256_add_epi16(c, d));
+  }
+  column_add_scalar(nb-k, column+k, child_column+k);
+}
+
+__attribute__((target("avx2")))
+static void interval_to_column_avx2(int nb, const short unsigned *first, const short unsigned *span, int rank, short unsigned *column){
+  int k;
+  __m256i vrank = _mm256_set1_epi16((short)rank);
+  __m256i one = _mm256_set1_epi16(1);
+  for(k=0; k+16<=nb; k+=16){
+    __m256i x = _mm256_sub_epi16(vrank, _mm256_loadu_si256((const __m256i*)(first+k)));
+    __m256i s = _mm256_loadu_si256((const __m256i*)(span+k));
+    _mm256_storeu_si256((__m256i*)(column+k), _mm256_and_si256(_mm256_cmpeq_epi16(_mm256_max_epu16(x, s), s), one));
+  }
+  for(; k<nb; k++) column[k] = ((short unsigned)(rank - first[k]) <= span[k]);
+}
+
+__attribute__((target("avx2")))
+static void column_min_keys_avx2(int nb, const short unsigned *items, const short unsigned *column, int card,
+				 int nb_taxa, uint32_t rank, uint32_t *min_key){
+  int k;
+  __m256i vcard = _mm256_set1_epi16((short)card);
+  __m256i vn = _mm256_set1_epi16((short)nb_taxa);
+  __m256i vhalf1 = _mm256_set1_epi16((short)(nb_taxa/2+1));
+  __m256i vrank = _mm256_set1_epi32((int)rank);
+  for(k=0; k+16<=nb; k+=16){
+    __m256i c = _mm256_loadu_si256((const __m256i*)(column+k));
+    __m256i it = _mm256_loadu_si256((const __m256i*)(items+k));
+    __m256i dist = _mm256_sub_epi16(_mm256_add_epi16(it, vcard), _mm256_add_epi16(c, c));
+    __m256i fold = _mm256_cmpeq_epi16(_mm256_max_epu16(dist, vhalf1), dist);
+    dist = _mm256_blendv_epi8(dist, _mm256_sub_epi16(vn, dist), fold);
+    __m256i key_lo = _mm256_or_si256(_mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(dist)), TBE_RANK_BITS), vrank);
+    __m256i key_hi = _mm256_or_si256(_mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(dist, 1)), TBE_RANK_BITS), vrank);
+    __m256i min_lo = _mm256_loadu_si256((const __m256i*)(min_key+k));
+    __m256i min_hi = _mm256_loadu_si256((const __m256i*)(min_key+k+8));
+    _mm256_storeu_si256((__m256i*)(min_key+k), _mm256_min_epu32(min_lo, key_lo));
+    _mm256_storeu_si256((__m256i*)(min_key+k+8), _mm256_min_epu32(min_hi, key_hi));
+  }
+  column_min_keys_scalar(nb-k, items+k, column+k, card, nb_taxa, rank, min_key+k);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void column_add_avx512(int nb, short unsigned *column, const short unsigned *child_column){
+  int k;
+  for(k=0; k+32<=nb; k+=32){
+    __m512i c = _mm512_loadu_si512((const void*)(column+k));
+    __m512i d = _mm512_loadu_si512((const void*)(child_column+k));
+    _mm512_storeu_si512((void*)(column+k), _mm512_add_epi16(c, d));
+  }
+  column_add_scalar(nb-k, column+k, child_column+k);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void interval_to_column_avx512(int nb, const short unsigned *first, const short unsigned *span, int rank, short unsigned *column){
+  int k;
+  __m512i vrank = _mm512_set1_epi16((short)rank);
+  __m512i one = _mm512_set1_epi16(1);
+  for(k=0; k+32<=nb; k+=32){
+    __m512i x = _mm512_sub_epi16(vrank, _mm512_loadu_si512((const void*)(first+k)));
+    __mmask32 in = _mm512_cmple_epu16_mask(x, _mm512_loadu_si512((const void*)(span+k)));
+    _mm512_storeu_si512((void*)(column+k), _mm512_maskz_mov_epi16(in, one));
+  }
+  for(; k<nb; k++) column[k] = ((short unsigned)(rank - first[k]) <= span[k]);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void column_min_keys_avx512(int nb, const short unsigned *items, const short unsigned *column, int card,
+				   int nb_taxa, uint32_t rank, uint32_t *min_key){
+  int k;
+  __m512i vcard = _mm512_set1_epi16((short)card);
+  __m512i vn = _mm512_set1_epi16((short)nb_taxa);
+  __m512i vhalf = _mm512_set1_epi16((short)(nb_taxa/2));
+  __m512i vrank = _mm512_set1_epi32((int)rank);
+  for(k=0; k+32<=nb; k+=32){
+    __m512i c = _mm512_loadu_si512((const void*)(column+k));
+    __m512i it = _mm512_loadu_si512((const void*)(items+k));
+    __m512i dist = _mm512_sub_epi16(_mm512_add_epi16(it, vcard), _mm512_add_epi16(c, c));
+    __mmask32 fold = _mm512_cmpgt_epu16_mask(dist, vhalf);
+    dist = _mm512_mask_sub_epi16(dist, fold, vn, dist);
+    __m512i key_lo = _mm512_or_si512(_mm512_slli_epi32(_mm512_cvtepu16_epi32(_mm512_castsi512_si256(dist)), TBE_RANK_BITS), vrank);
+    __m512i key_hi = _mm512_or_si512(_mm512_slli_epi32(_mm512_cvtepu16_epi32(_mm512_extracti64x4_epi64(dist, 1)), TBE_RANK_BITS), vrank);
+    __m512i min_lo = _mm512_loadu_si512((const void*)(min_key+k));
+    __m512i min_hi = _mm512_loadu_si512((const void*)(min_key+k+16));
+    _mm512_storeu_si512((void*)(min_key+k), _mm512_min_epu32(min_lo, key_lo));
+    _mm512_storeu_si512((void*)(min_key+k+16), _mm512_min_epu32(min_hi, key_hi));
+  }
+  column_min_keys_scalar(nb-k, items+k, column+k, card, nb_taxa, rank, min_key+k);
+}
+
+#endif
+
+void (*tbe_column_add)(int nb, short unsigned *column, const short unsigned *child_column) = column_add_scalar;
+void (*tbe_column_min_keys)(int nb, const short unsigned *items, const short unsigned *column, int card,
+			    int nb_taxa, uint32_t rank, uint32_t *min_key) = column_min_keys_scalar;
+void (*tbe_interval_to_column)(int nb, const short unsigned *first, const short unsigned *span, int rank,
+			       short unsigned *column) = interval_to_column_scalar;
+static int current_level = TBE_SIMD_SCALAR;
+
+int tbe_simd_supported(int level){
+  switch(level){
+  case TBE_SIMD_SCALAR: return 1;
+#ifdef TBE_SIMD_X86
+  case TBE_SIMD_AVX2: return __builtin_cpu_supports("avx2");
+  case TBE_SIMD_AVX512: return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+  default: return 0;
+  }
+}
+
+int tbe_simd_select(int level){
+  if(level == TBE_SIMD_AUTO){
+    level = TBE_SIMD_AVX512;
+    while(!tbe_simd_supported(level)) level--;
+  }
+  if(!tbe_simd_supported(level)) return -1;
+  switch(level){
+#ifdef TBE_SIMD_X86
+  case TBE_SIMD_AVX2:
+    tbe_column_add = column_add_avx2;
+    tbe_column_min_keys = column_min_keys_avx2;
+    tbe_interval_to_column = interval_to_column_avx2;
+    break;
+  case TBE_SIMD_AVX512:
+    tbe_column_add = column_add_avx512;
+    tbe_column_min_keys = column_min_keys_avx512;
+    tbe_interval_to_column = interval_to_column_avx512;
+    break;
+#endif
+  default:
+    tbe_column_add = column_add_scalar;
+    tbe_column_min_keys = column_min_keys_scalar;
+    tbe_interval_to_column = interval_to_column_scalar;
+  }
+  current_level = level;
+  return level;
+}
+
+int tbe_simd_level(){
+  return current_level;
+}
+
+const char* tbe_simd_name(int level){
+  switch(level){
+  case TBE_SIMD_SCALAR: return "scalar";
+  case TBE_SIMD_AVX2: return "avx2";
+  case TBE_SIMD_AVX512: return "avx512";
+  default: return "auto";
+  }
+}
@@ -0,0 +1,68 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _TRANSFER_SIMD_H_
+#define _TRANSFER_SIMD_H_
+
+#include <stdint.h>
+
+/*
+  Inner loops of the transfer kernels (transfer.c), on one column of the I matrix: 
+  - column add: column[k] += child_column[k]
+  - leaf column: column[k] = 1 iff first[k] <= rank <= first[k] + span[k] (the rank of a taxon in
+    the clade of ref edge k, in the depth first order of the ref tree)
+  - distance and min: for each internal ref edge k, dist = items[k] + card - 2*column[k], folded to 
+    min(dist, nb_taxa-dist), and min_key[k] = min(min_key[k], dist << TBE_RANK_BITS | rank).
+  The distances are computed in 16-bit lanes (nb_taxa < 65536), the keys in 32-bit lanes.
+  Hand-written AVX2 and AVX-512 versions are selected at run time on x86 if the cpu supports them,
+  the portable C version is used otherwise.
+*/
+
+/* bootstrap trees have less than 2*65535 edges (Taxon_id) */
+#define TBE_RANK_BITS 17
+/* the distances are unsigned short: the transfer kernels need less than 65536 taxa */
+#define TBE_MAX_TAXA 65535
+
+#define TBE_SIMD_AUTO   -1
+#define TBE_SIMD_SCALAR  0
+#define TBE_SIMD_AVX2    1
+#define TBE_SIMD_AVX512  2
+
+extern void (*tbe_column_add)(int nb, short unsigned *column, const short unsigned *child_column);
+extern void (*tbe_column_min_keys)(int nb, const short unsigned *items, const short unsigned *column, int card,
+				   int nb_taxa, uint32_t rank, uint32_t *min_key);
+extern void (*tbe_interval_to_column)(int nb, const short unsigned *first, const short unsigned *span, int rank,
+				      short unsigned *column);
+
+// 1 if the kernels of this level can run on this cpu
+int tbe_simd_supported(int level);
+// Selects the kernels of the given level (TBE_SIMD_AUTO: the best supported one), before the parallel sections.
+// Returns the selected level, or -1 if the level is not supported (the kernels are then unchanged)
+int tbe_simd_select(int level);
+// Level currently selected
+int tbe_simd_level();
+const char* tbe_simd_name(int level);
+
+#endif
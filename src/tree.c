@@ -1372,11 +1372,15 @@ Tree* parse_nh_string(char* in_str) {
 
 
 Tree *complete_parse_nh(char* big_string, char*** taxname_lookup_table) {
-	/* trick: iff taxname_lookup_table is NULL, we set it according to the tree read, otherwise we use it as the reference taxname lookup table */
-	int i;
  	Tree* mytree = parse_nh_string(big_string); 
 	if(mytree == NULL) { fprintf(stderr,"Not a syntactically correct NH tree.\n"); return NULL; }
+	return complete_parsed_tree(mytree, taxname_lookup_table);
+}
 
+
+Tree *complete_parsed_tree(Tree* mytree, char*** taxname_lookup_table) {
+	/* trick: iff taxname_lookup_table is NULL, we set it according to the tree read, otherwise we use it as the reference taxname lookup table */
+	int i;
 	if(*taxname_lookup_table == NULL)  *taxname_lookup_table = build_taxname_lookup_table(mytree);
 	mytree->taxname_lookup_table = *taxname_lookup_table;
 
@@ -1740,11 +1744,24 @@ void update_hashtables_pre_alltree(Tree* tree) {
 
 /* UNION AND INTERSECT CALCULATIONS (FOR THE TRANSFER METHOD) */
 
-void update_i_c_post_order_ref_tree(Tree* ref_tree, Node* orig, Node* target, Tree* boot_tree, short unsigned** i_matrix, short unsigned** c_matrix) {
+void taxon_terminal_edges(Tree* tree, int* leaf_edge) {
+	/* fills leaf_edge[taxon id] with the id of the terminal edge of tree leading to this taxon.
+	   Both trees share the taxname_lookup_table, so that a ref leaf finds its boot terminal edge
+	   by direct indexing instead of comparing names. */
+	int j;
+	for (j=0; j < tree->nb_edges; j++) {
+		if(tree->a_edges[j]->right->nneigh != 1) continue;
+		leaf_edge[first_id(tree->a_edges[j]->hashtbl[1])] = j;
+	}
+} /* end taxon_terminal_edges */
+
+
+void update_i_post_order_ref_tree(Tree* ref_tree, Node* orig, Node* target, Tree* boot_tree, short unsigned** i_matrix,
+				  short unsigned* min_dist, short unsigned* min_dist_edge, int* boot_leaf_edge) {
 	/* this function does the post-order traversal (recursive from the pseudoroot to the leaves, updating knowledge for the subtrees)
 	   of the reference tree, examining only leaves (terminal edges) of the bootstrap tree.
-	   It sends a probe from the orig node to the target node (nodes in ref_tree), calculating I_ij and C_ij
-	   (see Brehelin, Gascuel, Martin 2008). */
+	   It sends a probe from the orig node to the target node (nodes in ref_tree), calculating I_ij
+	   (see Brehelin, Gascuel, Martin 2008). C_ij is not stored: it is the size of the boot clade j minus I_ij. */
 	int j, k, dir, orig_to_target, target_to_orig;
 	Edge* my_br; /* branch of the ref tree connecting orig to target */
 	int edge_id; /* its id */
@@ -1758,78 +1775,75 @@ void update_i_c_post_order_ref_tree(Tree* ref_tree, Node* orig, Node* target, Tr
 	assert(target==my_br->right); /* the descendant should always be the right side of the edge */
 
 	if(target->nneigh == 1) {
-		for (j=0; j < boot_tree->nb_edges; j++) { /* for all the terminal edges of boot_tree */ 
-			if(boot_tree->a_edges[j]->right->nneigh != 1) continue;
-			/* we only want to scan terminal edges of boot_tree, where the right son is a leaf */
-			/* else we update all the I_ij and C_ij with i = edge_id */
-			if (strcmp(target->name,boot_tree->a_edges[j]->right->name)) {
-				/* here the taxa are different */
-				i_matrix[edge_id][j] = 0;
-				c_matrix[edge_id][j] = 1;
-			} else {
-				/* same taxa here in T_ref and T_boot */
-				i_matrix[edge_id][j] = 1;
-				c_matrix[edge_id][j] = 0;
-			}
-		} /* end for on all edges of T_boot, for my_br being terminal */
+		/* same taxon in T_ref and T_boot: a terminal edge is always at distance 0 from the terminal edge
+		   found through boot_leaf_edge. Its row is not read: the father sets its only non zero cell
+		   itself, and the boot tree recurrence skips it */
+		j = boot_leaf_edge[first_id(my_br->hashtbl[1])];
+		min_dist[edge_id] = 0;
+		min_dist_edge[edge_id] = j;
 	} else {
 		/* now the case where my_br is not a terminal edge */
 		/* first initialise (zero) the cells we are going to update */
 		for (j=0; j < boot_tree->nb_edges; j++)
 		  /**
-		     We initialize the i and c matrices for the edge edge_id with :
-		     * 0 for i : because afterwards we do i[edge_id] = i[edge_id] || i[edge_id2]
-		     * 1 for c : because afterwards we do c[edge_id] = c[edge_id] && c[edge_id2]
+		     We initialize the i matrix for the edge edge_id with 0,
+		     because afterwards we do i[edge_id] = i[edge_id] || i[edge_id2]
 		  */
 		  if(boot_tree->a_edges[j]->right->nneigh == 1){
 		    i_matrix[edge_id][j] = 0;
-		    c_matrix[edge_id][j] = 1;
 		  }
 
 		for (k = 1; k < target->nneigh; k++) {
 			dir = (target_to_orig + k) % target->nneigh; /* direction from target to one of its "sons" (== not orig) */
-			update_i_c_post_order_ref_tree(ref_tree, target, target->neigh[dir], boot_tree, i_matrix, c_matrix);
+			update_i_post_order_ref_tree(ref_tree, target, target->neigh[dir], boot_tree, i_matrix, min_dist, min_dist_edge, boot_leaf_edge);
+			if(target->neigh[dir]->nneigh == 1) {
+				/* a ref leaf: the terminal edge of its taxon in T_boot, instead of a whole row */
+				i_matrix[edge_id][boot_leaf_edge[first_id(target->br[dir]->hashtbl[1])]] = 1;
+				continue;
+			}
 			edge_id2 = target->br[dir]->id;
 			for (j=0; j < boot_tree->nb_edges; j++) { /* for all the terminal edges of boot_tree */ 
 				if(boot_tree->a_edges[j]->right->nneigh != 1) continue;
 
 				i_matrix[edge_id][j] = i_matrix[edge_id][j] || i_matrix[edge_id2][j];
 				/* above is an OR between two integers, result is 0 or 1 */
-
-				c_matrix[edge_id][j] = c_matrix[edge_id][j] && c_matrix[edge_id2][j];
-				/* above is an AND between two integers, result is 0 or 1 */
-
 			} /* end for j */
 		} /* end for on all edges of T_boot, for my_br being internal */
 
 	} /* ending the case where my_br is an internal edge */
 	
-} /* end update_i_c_post_order_ref_tree */
+} /* end update_i_post_order_ref_tree */
 
 
-void update_all_i_c_post_order_ref_tree(Tree* ref_tree, Tree* boot_tree, short unsigned** i_matrix, short unsigned** c_matrix) {
-	/* this function is the first step of the union and intersection calculations */
+void update_all_i_post_order_ref_tree(Tree* ref_tree, Tree* boot_tree, short unsigned** i_matrix, short unsigned* min_dist, short unsigned* min_dist_edge,
+				      int* boot_leaf_edge) {
+	/* this function is the first step of the intersection calculations */
+	/* boot_leaf_edge (size nb_taxa) is filled with the terminal edge of each taxon in boot_tree */
 	Node* root = ref_tree->node0;
 	int i, n = root->nneigh;
-	for(i=0; i<n; i++) update_i_c_post_order_ref_tree(ref_tree, root, root->neigh[i], boot_tree, i_matrix, c_matrix);
-} /* end update_all_i_c_post_order_ref_tree */
+	taxon_terminal_edges(boot_tree, boot_leaf_edge);
+	for(i=0; i<n; i++) update_i_post_order_ref_tree(ref_tree, root, root->neigh[i], boot_tree, i_matrix, min_dist, min_dist_edge, boot_leaf_edge);
+} /* end update_all_i_post_order_ref_tree */
 
 
 
 
 
-void update_i_c_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, Node* orig, Node* target, short unsigned** i_matrix, short unsigned** c_matrix,
-				     short unsigned** hamming, short unsigned* min_dist, short unsigned* min_dist_edge) {
+int update_i_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, Node* orig, Node* target, short unsigned** i_matrix,
+				  short unsigned* min_dist, short unsigned* min_dist_edge) {
 	/* here we implement the second part of the Brehelin/Gascuel/Martin algorithm:
 	   post-order traversal of the bootstrap tree, and numerical recurrence. */
 	/* in this function, orig and target are nodes of boot_tree (aka T_boot). */
 	/* min_dist is an array whose size is equal to the number of edges in T_ref.
 	   It gives for each edge of T_ref its min distance to a split in T_boot. */
+	/* returns the number of taxa below target (the boot clade), so that C_ij = card - I_ij need not be stored */
 
 	int i, j, dir, orig_to_target, target_to_orig;
 	Edge* my_br; /* branch of the boot tree connecting orig to target */
 	int edge_id /* its id */, edge_id2 /* id of descending branches. */;
 	int N = ref_tree->nb_taxa;
+	int card = 1; /* number of taxa in the boot clade */
+	int dist;
 
 	/* we first have to determine which is the direction of the edge (orig -> target and target -> orig) */
 	orig_to_target = dir_a_to_b(orig,target);
@@ -1838,53 +1852,55 @@ void update_i_c_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, Node* orig
 	edge_id = my_br->id; /* here this is an edge_id corresponding to T_boot */
 
 	if(target->nneigh != 1) {
-		/* because nothing to do in the case where target is a leaf: intersection and union already ok. */
+		/* because nothing to do in the case where target is a leaf: intersection already ok. */
 		/* otherwise, keep on posttraversing in all other directions */
 
-		/* first initialise (zero) the cells we are going to update */
-		for (i=0; i < ref_tree->nb_edges; i++) i_matrix[i][edge_id] = c_matrix[i][edge_id] = 0;
+		/* first initialise (zero) the cells we are going to update. Rows of terminal edges of T_ref are skipped:
+		   they are always at distance 0 from the terminal edge of the same taxon */
+		card = 0;
+		for (i=0; i < ref_tree->nb_edges; i++) i_matrix[i][edge_id] = 0;
 
 		for(j=1;j<target->nneigh;j++) {
 			dir = (target_to_orig + j) % target->nneigh;
 			edge_id2 = target->br[dir]->id;
-			update_i_c_post_order_boot_tree(ref_tree, boot_tree, target, target->neigh[dir],
-							i_matrix, c_matrix, hamming, min_dist, min_dist_edge);
+			card += update_i_post_order_boot_tree(ref_tree, boot_tree, target, target->neigh[dir],
+							      i_matrix, min_dist, min_dist_edge);
 			for (i=0; i < ref_tree->nb_edges; i++) { /* for all the edges of ref_tree */ 
+				if(ref_tree->a_edges[i]->right->nneigh == 1) continue;
 				i_matrix[i][edge_id] += i_matrix[i][edge_id2];
-				c_matrix[i][edge_id] += c_matrix[i][edge_id2];
 			} /* end for i */
 		} 
 
 	} /* end if target is not a leaf: the following loop is performed in all cases */
 
-	for (i=0; i<ref_tree->nb_edges; i++) { /* for all the edges of ref_tree */ 
+	for (i=0; i<ref_tree->nb_edges; i++) { /* for all the internal edges of ref_tree */ 
+		if(ref_tree->a_edges[i]->right->nneigh == 1) continue;
 		/* at this point we can calculate in all cases (internal branch or not) the Hamming distance at [i][edge_id], */
-		hamming[i][edge_id] = /* card of union minus card of intersection */ 
+		dist = /* card of union minus card of intersection */ 
 			ref_tree->a_edges[i]->hashtbl[1]->num_items /* #taxa in the cluster i of T_ref */
-			+ c_matrix[i][edge_id] /* #taxa in cluster edge_id of T_boot BUT NOT in cluster i of T_ref */
+			+ card - i_matrix[i][edge_id] /* #taxa in cluster edge_id of T_boot BUT NOT in cluster i of T_ref */
 			- i_matrix[i][edge_id]; /* #taxa in the intersection of the two clusters */
 
-		/* NEW!! Let's immediately calculate the right ditance, taking into account the fact that the true disance is min (dist, N-dist) */
-		if (hamming[i][edge_id] > N/2 /* floor value */) hamming[i][edge_id] = N - hamming[i][edge_id];
-		
+		/* the true distance is min (dist, N-dist) */
+		if (dist > N/2 /* floor value */) dist = N - dist;
 
-		/*   and update the min of all Hamming (TRANSFER) distances hamming[i][j] over all j */
-		if (hamming[i][edge_id] < min_dist[i]){
-			min_dist[i] = hamming[i][edge_id];
+		/*   and update the min of all Hamming (TRANSFER) distances over all boot edges */
+		if (dist < min_dist[i]){
+			min_dist[i] = dist;
 			min_dist_edge[i] = edge_id;
 		}
 			
 	} /* end for on all edges of T_ref */
-	
-} /* end update_i_c_post_order_boot_tree */
+
+	return card;
+} /* end update_i_post_order_boot_tree */
 
 
-void update_all_i_c_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, short unsigned** i_matrix, short unsigned** c_matrix,
-					 short unsigned** hamming, short unsigned* min_dist, short unsigned* min_dist_edge) {
-	/* this function is the second step of the union and intersection calculations */
+void update_all_i_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, short unsigned** i_matrix, short unsigned* min_dist, short unsigned* min_dist_edge) {
+	/* this function is the second step of the intersection calculations */
 	Node* root = boot_tree->node0;
 	int i, n = root->nneigh;
-	for(i=0 ; i<n ; i++) update_i_c_post_order_boot_tree(ref_tree, boot_tree, root, root->neigh[i], i_matrix, c_matrix, hamming, min_dist, min_dist_edge);
+	for(i=0 ; i<n ; i++) update_i_post_order_boot_tree(ref_tree, boot_tree, root, root->neigh[i], i_matrix, min_dist, min_dist_edge);
 
 	/* and then some checks to make sure everything went ok */
 	for(i=0; i<ref_tree->nb_edges; i++) {
@@ -1892,7 +1908,7 @@ void update_all_i_c_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, short
 		if(ref_tree->a_edges[i]->right->nneigh == 1)
 			assert(min_dist[i] == 0); /* any terminal edge should have an exact match in any bootstrap tree */
 	}
-} /* end update_all_i_c_post_order_boot_tree */
+} /* end update_all_i_post_order_boot_tree */
 
 
 
@@ -199,6 +199,8 @@ Tree* parse_nh_string(char* in_str);
 
 /* complete parse tree: parse NH string, update hashtables and subtype counts */
 Tree *complete_parse_nh(char* big_string, char*** taxname_lookup_table);
+/* same, for a tree already parsed by parse_nh_string */
+Tree *complete_parsed_tree(Tree* mytree, char*** taxname_lookup_table);
 
 
 /* taxname lookup table functions */
@@ -258,11 +260,12 @@ void update_hashtables_pre_alltree(Tree* tree);
 
 
 /* UNION AND INTERSECT CALCULATIONS FOR THE TRANSFER METHOD (from Bréhélin/Gascuel/Martin 2008) */
-void update_i_c_post_order_ref_tree(Tree* ref_tree, Node* orig, Node* target, Tree* boot_tree, short unsigned** i_matrix, short unsigned** c_matrix);
-void update_all_i_c_post_order_ref_tree(Tree* ref_tree, Tree* boot_tree, short unsigned** i_matrix, short unsigned** c_matrix);
+void taxon_terminal_edges(Tree* tree, int* leaf_edge);
+void update_i_post_order_ref_tree(Tree* ref_tree, Node* orig, Node* target, Tree* boot_tree, short unsigned** i_matrix, short unsigned* min_dist, short unsigned* min_dist_edge, int* boot_leaf_edge);
+void update_all_i_post_order_ref_tree(Tree* ref_tree, Tree* boot_tree, short unsigned** i_matrix, short unsigned* min_dist, short unsigned* min_dist_edge, int* boot_leaf_edge);
 
-void update_i_c_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, Node* orig, Node* target, short unsigned** i_matrix, short unsigned** c_matrix, short unsigned** hamming, short unsigned* min_dist, short unsigned* min_dist_edge);
-void update_all_i_c_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, short unsigned** i_matrix, short unsigned** c_matrix, short unsigned** hamming, short unsigned* min_dist, short unsigned* min_dist_edge);
+int update_i_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, Node* orig, Node* target, short unsigned** i_matrix, short unsigned* min_dist, short unsigned* min_dist_edge);
+void update_all_i_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, short unsigned** i_matrix, short unsigned* min_dist, short unsigned* min_dist_edge);
 
 
 /*Generate Random Tree*/
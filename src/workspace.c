@@ -0,0 +1,235 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "workspace.h"
+#include <stdio.h>
+#include <string.h>
+#include "io.h"
+#ifdef __linux__
+#include <sys/mman.h> /* madvise */
+#endif
+
+void* aligned_malloc(size_t size, int huge_pages){
+  void *ptr = NULL;
+  size_t align = WORKSPACE_ALIGN;
+  if(size == 0) size = WORKSPACE_ALIGN;
+#ifdef _WIN32
+  ptr = _aligned_malloc(size, align);
+#else
+  if(huge_pages && size >= WORKSPACE_HUGE_PAGE) align = WORKSPACE_HUGE_PAGE;
+  if(posix_memalign(&ptr, align, size) != 0) ptr = NULL;
+#endif
+  if(ptr == NULL){
+    fprintf(stderr,"Could not allocate %lu bytes. Aborting.\n", (unsigned long)size);
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  if(huge_pages && size >= WORKSPACE_HUGE_PAGE) madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+  return ptr;
+}
+
+void aligned_free(void *ptr){
+#ifdef _WIN32
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+int tbe_nb_columns(int nb_taxa){
+  /* a column is held by each ancestor whose light child is being visited, and by the current edge */
+  int size = 2;
+  while(nb_taxa >>= 1) size++;
+  return size;
+}
+
+/* number of elements of a row/column padded to a whole number of cache lines */
+static int padded_length(int length, size_t elt_size){
+  int per_line = WORKSPACE_ALIGN / elt_size;
+  return ((length + per_line - 1) / per_line) * per_line;
+}
+
+tbe_workspace* new_tbe_workspace(int nb_taxa, int nb_edges_ref, int nb_rows, int kernel, int huge_pages){
+  int i;
+  tbe_workspace *ws = malloc(sizeof(tbe_workspace));
+  ws->nb_taxa = nb_taxa;
+  ws->nb_edges_ref = nb_edges_ref;
+  ws->nb_rows = nb_rows;
+  ws->nb_edges_boot = 2*nb_taxa-2;
+  ws->huge_pages = huge_pages;
+  ws->kernel = kernel;
+  ws->stride = padded_length(nb_rows, sizeof(short unsigned));
+
+  ws->i_block = NULL;
+  ws->col_block = NULL;
+  ws->free_columns = NULL;
+  ws->boot_bits = NULL;
+  ws->rank_card = NULL;
+  ws->boot_fp = NULL;
+  ws->fp_slots = NULL;
+  ws->program = NULL;
+  ws->program_length = 0;
+  ws->path_parent = ws->path_head = ws->path_pos = NULL;
+  ws->seg_size = 0;
+  ws->seg_min = ws->seg_max = ws->seg_add = NULL;
+  ws->sparse_parent = ws->sparse_heavy = ws->euler_in = ws->euler_out = NULL;
+  ws->overlap = ws->touched = ws->side = NULL;
+  ws->match = ws->shared = ws->kept = ws->meta_first = ws->meta_span = NULL;
+  ws->kept_items = ws->kept_first = ws->kept_span = NULL;
+  ws->cache = NULL;
+  ws->nb_parts = 0;
+  ws->parts = NULL;
+  ws->subtree_fp = NULL;
+  ws->subtree_edges = NULL;
+  ws->record_keys = NULL;
+  ws->nb_columns = ws->nb_free = ws->max_live = 0;
+  ws->nb_chunks = (nb_taxa + 8*sizeof(unsigned long) - 1) / (8*sizeof(unsigned long));
+  if(kernel == TBE_KERNEL_DENSE){
+    ws->i_block = aligned_malloc(((size_t)ws->nb_edges_boot) * ws->stride * sizeof(short unsigned), huge_pages);
+  } else if(kernel == TBE_KERNEL_POPCOUNT){
+    ws->boot_bits = aligned_malloc(((size_t)ws->nb_edges_boot) * ws->nb_chunks * sizeof(unsigned long), huge_pages);
+    ws->rank_card = malloc(ws->nb_edges_boot * sizeof(int));
+    ws->boot_fp = malloc(ws->nb_edges_boot * sizeof(fingerprint_t));
+    for(ws->fp_mask = 1; ws->fp_mask < 2*ws->nb_edges_boot; ws->fp_mask <<= 1);
+    ws->fp_slots = malloc(ws->fp_mask * sizeof(int));
+    ws->fp_mask--;
+  } else if(kernel == TBE_KERNEL_BATCH){
+    /* at most one leaf, one add and one min per edge, and one pop per edge of the root */
+    ws->program = malloc(3 * 4 * ws->nb_edges_boot * sizeof(int));
+    ws->nb_columns = tbe_nb_columns(nb_taxa);
+    ws->col_block = aligned_malloc(((size_t)ws->nb_columns) * TBE_BATCH_ROWS * sizeof(short unsigned), huge_pages);
+  } else if(kernel == TBE_KERNEL_FAST){
+    ws->path_parent = malloc(ws->nb_edges_boot * sizeof(int));
+    ws->path_head = malloc(ws->nb_edges_boot * sizeof(int));
+    ws->path_pos = malloc(ws->nb_edges_boot * sizeof(int));
+    for(ws->seg_size = 1; ws->seg_size < ws->nb_edges_boot; ws->seg_size <<= 1);
+    ws->seg_min = aligned_malloc(2 * ws->seg_size * sizeof(int64_t), huge_pages);
+    ws->seg_max = aligned_malloc(2 * ws->seg_size * sizeof(int64_t), huge_pages);
+    ws->seg_add = aligned_malloc(2 * ws->seg_size * sizeof(int64_t), huge_pages);
+  } else if(kernel != TBE_KERNEL_ROWS){
+    /* the rows kernel has the columns of its parts only */
+    ws->nb_columns = ws->nb_free = tbe_nb_columns(nb_taxa);
+    ws->col_block = aligned_malloc(((size_t)ws->nb_columns) * ws->stride * sizeof(short unsigned), huge_pages);
+    ws->free_columns = malloc(ws->nb_columns * sizeof(short unsigned*));
+    for(i=0; i<ws->nb_columns; i++) ws->free_columns[i] = ws->col_block + ((size_t)i) * ws->stride;
+  }
+  if(kernel == TBE_KERNEL_CONTRACT){
+    ws->boot_fp = malloc(ws->nb_edges_boot * sizeof(fingerprint_t));
+    for(ws->fp_mask = 1; ws->fp_mask < 2*ws->nb_edges_boot; ws->fp_mask <<= 1);
+    ws->fp_slots = malloc(ws->fp_mask * sizeof(int));
+    ws->fp_mask--;
+    ws->match = malloc(nb_rows * sizeof(int));
+    ws->shared = malloc(nb_rows * sizeof(int));
+    ws->kept = malloc(nb_rows * sizeof(int));
+    ws->kept_items = aligned_malloc(ws->stride * sizeof(short unsigned), 0);
+    ws->kept_first = aligned_malloc(ws->stride * sizeof(short unsigned), 0);
+    ws->kept_span = aligned_malloc(ws->stride * sizeof(short unsigned), 0);
+    ws->meta_first = malloc(ws->nb_edges_boot * sizeof(int));
+    ws->meta_span = malloc(ws->nb_edges_boot * sizeof(int));
+  }
+  if(kernel == TBE_KERNEL_SPARSE){
+    ws->sparse_parent = malloc(ws->nb_edges_boot * sizeof(int));
+    ws->sparse_heavy = malloc(ws->nb_edges_boot * sizeof(int));
+    ws->euler_in = malloc(ws->nb_edges_boot * sizeof(int));
+    ws->euler_out = malloc(ws->nb_edges_boot * sizeof(int));
+    ws->overlap = calloc(ws->nb_edges_boot, sizeof(int));
+    ws->touched = malloc(ws->nb_edges_boot * sizeof(int));
+    ws->side = malloc(nb_taxa * sizeof(int));
+  }
+  ws->card = malloc(ws->nb_edges_boot * sizeof(int));
+  ws->rank = malloc(ws->nb_edges_boot * sizeof(int));
+  ws->rank_edge = malloc(ws->nb_edges_boot * sizeof(int));
+  ws->boot_leaf_edge = malloc(nb_taxa * sizeof(int));
+  ws->min_key = aligned_malloc(padded_length(nb_rows, sizeof(uint32_t)) * sizeof(uint32_t), 0);
+  ws->key_target = ws->min_key;
+  ws->key_base = 0;
+
+  ws->min_dist = aligned_malloc(nb_edges_ref * sizeof(short unsigned), 0);
+  ws->min_dist_edge = aligned_malloc(nb_edges_ref * sizeof(short unsigned), 0);
+  ws->moved_species = malloc(nb_taxa * sizeof(int));
+  ws->species = malloc(nb_taxa * sizeof(int));
+  return ws;
+}
+
+void tbe_workspace_add_cache(tbe_workspace *ws, struct column_cache *cache){
+  if(ws->cache != NULL) return;
+  ws->cache = cache;
+  ws->subtree_fp = malloc(ws->nb_edges_boot * sizeof(fingerprint_t));
+  ws->subtree_edges = malloc(ws->nb_edges_boot * sizeof(int));
+  ws->record_keys = aligned_malloc(padded_length(ws->nb_rows, sizeof(uint32_t)) * sizeof(uint32_t), 0);
+}
+
+void free_tbe_workspace(tbe_workspace *ws){
+  int i;
+  if(ws->i_block != NULL) aligned_free(ws->i_block);
+  if(ws->col_block != NULL) aligned_free(ws->col_block);
+  if(ws->boot_bits != NULL) aligned_free(ws->boot_bits);
+  free(ws->rank_card);
+  free(ws->boot_fp);
+  free(ws->fp_slots);
+  free(ws->program);
+  free(ws->path_parent);
+  free(ws->path_head);
+  free(ws->path_pos);
+  free(ws->sparse_parent);
+  free(ws->sparse_heavy);
+  free(ws->euler_in);
+  free(ws->euler_out);
+  free(ws->overlap);
+  free(ws->touched);
+  free(ws->side);
+  free(ws->match);
+  free(ws->shared);
+  free(ws->kept);
+  if(ws->kept_items != NULL){
+    aligned_free(ws->kept_items);
+    aligned_free(ws->kept_first);
+    aligned_free(ws->kept_span);
+  }
+  free(ws->meta_first);
+  free(ws->meta_span);
+  for(i=0; i<ws->nb_parts; i++) free_tbe_workspace(ws->parts[i]);
+  free(ws->parts);
+  free(ws->subtree_fp);
+  free(ws->subtree_edges);
+  if(ws->record_keys != NULL) aligned_free(ws->record_keys);
+  if(ws->seg_min != NULL){
+    aligned_free(ws->seg_min);
+    aligned_free(ws->seg_max);
+    aligned_free(ws->seg_add);
+  }
+  free(ws->free_columns);
+  free(ws->card);
+  free(ws->rank);
+  free(ws->rank_edge);
+  free(ws->boot_leaf_edge);
+  aligned_free(ws->min_key);
+  aligned_free(ws->min_dist);
+  aligned_free(ws->min_dist_edge);
+  free(ws->moved_species);
+  free(ws->species);
+  free(ws);
+}
@@ -0,0 +1,175 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _WORKSPACE_H_
+#define _WORKSPACE_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "fingerprint.h"
+
+/*
+  Per-thread workspace of the transfer (tbe) computation.
+  It is allocated once per thread, sized from the number of taxa (the bootstrap trees have at most
+  2*nb_taxa-3 edges), and reused for all the bootstrap trees analyzed by this thread, so that there
+  is no allocation in the loop over bootstrap trees. 
+  The large arrays are 64 bytes aligned (cache lines), and optionally backed by transparent huge pages.
+  The intersection columns (one element per internal ref edge) are contiguous and padded to whole cache lines.
+*/
+
+#define WORKSPACE_ALIGN 64
+#define WORKSPACE_HUGE_PAGE (2UL << 20)
+
+/* kernels computing the min transfer distances (transfer.c) */
+#define TBE_KERNEL_AUTO     0 /* dense, or columns if the I matrix is too large */
+#define TBE_KERNEL_DENSE    1
+#define TBE_KERNEL_COLUMNS  2
+#define TBE_KERNEL_POPCOUNT 3
+#define TBE_KERNEL_BATCH    4 /* columns kernel run on several trees, by tiles of ref rows */
+#define TBE_KERNEL_FAST     5 /* heavy paths of the boot tree in a segment tree */
+#define TBE_KERNEL_SPARSE   6 /* candidates above the leaves of the shallow ref clades, columns for the deep ones */
+#define TBE_KERNEL_CONTRACT 7 /* columns kernel on the trees reduced by their common subtrees */
+#define TBE_KERNEL_ROWS     8 /* columns kernel, the rows being split among the threads */
+
+/* rows of the ref tree processed at once by the batch kernel: the column stack stays in L1 */
+#define TBE_BATCH_ROWS 512
+
+typedef struct tbe_workspace{
+  int nb_taxa;
+  int nb_edges_ref;
+  int nb_rows;                /* number of internal ref edges: length of a column */
+  int nb_edges_boot;          /* max number of edges of a bootstrap tree */
+  int huge_pages;
+  int kernel;                 /* TBE_KERNEL_DENSE, _COLUMNS, _POPCOUNT, _BATCH, _FAST, _SPARSE, _CONTRACT or _ROWS */
+  int stride;                 /* padded length of a column */
+
+  /* dense kernel: I matrix stored column-major, one column per boot edge id. NULL for the column kernel */
+  short unsigned *i_block;
+
+  /* column kernel: the free columns in a stack */
+  int nb_columns;
+  int nb_free;
+  int max_live;               /* max number of columns used at the same time */
+  short unsigned *col_block;
+  short unsigned **free_columns;
+  int *card;                  /* number of taxa below each boot edge */
+  int *rank;                  /* rank of each boot edge in the standard post-order */
+
+  /* batch kernel: heavy first traversal of the boot tree compiled into a program on a stack of
+     columns of TBE_BATCH_ROWS elements (col_block) */
+  int *program;
+  int program_length;
+
+  /* popcount kernel: bitsets of the boot clades and their sizes, by rank, and an open addressing
+     table of the ranks by canonical fingerprint (boot_fp, by edge id), to find the exact matches */
+  int nb_chunks;
+  unsigned long *boot_bits;
+  int *rank_card;
+  fingerprint_t *boot_fp;
+  int fp_mask;
+  int *fp_slots;              /* rank+1, 0 if empty */
+
+  /* fast kernel: heavy path decomposition of the boot tree, by edge id, and segment tree over
+     the positions of the edges (leaves at seg_size + position): min and max keys of the subtree, 
+     including the pending add of the node */
+  int *path_parent;
+  int *path_head;
+  int *path_pos;
+  int seg_size;
+  int64_t *seg_min;
+  int64_t *seg_max;
+  int64_t *seg_add;
+
+  /* sparse kernel (with the columns of the column kernel for the deep edges): Euler tour of the 
+     boot tree, by edge id, number of taxa of the current ref side below each edge (0 between two
+     ref edges), and the edges where it is not 0 */
+  int *sparse_parent;
+  int *sparse_heavy;
+  int *euler_in;
+  int *euler_out;
+  int *overlap;
+  int *touched;
+  int *side;                  /* taxa of the smaller side of the current ref edge */
+
+  /* contract kernel (with the columns of the column kernel and the fingerprint table of the popcount kernel):
+     boot edge with the same bipartition as each internal ref edge (-1 if none), internal ref edges kept 
+     in the reduced ref tree and their metadata, and by boot edge id, the ref ranks of the taxa of the 
+     common subtree below it (meta_span -1 if the subtree below the edge is not common) */
+  int *match;
+  int *shared;
+  int *kept;
+  short unsigned *kept_items;
+  short unsigned *kept_first;
+  short unsigned *kept_span;
+  int *meta_first;
+  int *meta_span;
+
+  /* column cache (column kernel, tbe_workspace_add_cache): fingerprint of the ordered subtree below each
+     boot edge and its number of edges, by edge id. The min keys of the subtree being stored in the cache
+     go to record_keys, with ranks relative to key_base, instead of min_key */
+  struct column_cache *cache;
+  fingerprint_t *subtree_fp;
+  int *subtree_edges;
+  uint32_t *record_keys;
+  uint32_t *key_target;
+  int key_base;
+
+  /* rows kernel (tbe_workspace_add_parts): one workspace of the column kernel per block of rows */
+  int nb_parts;
+  struct tbe_workspace **parts;
+
+  /* all kernels */
+  int *rank_edge;             /* boot edge id of each rank */
+  int *boot_leaf_edge;        /* terminal boot edge of each taxon */
+  uint32_t *min_key;          /* for each internal ref edge: min of (dist << TBE_RANK_BITS | rank) */
+
+  /* results for one bootstrap tree */
+  short unsigned *min_dist;
+  short unsigned *min_dist_edge;
+
+  /* transfer index */
+  int *moved_species;         /* number of close branches around which each taxon moves */
+  int *species;               /* species to move around one branch */
+} tbe_workspace;
+
+/* column of the I matrix of a boot edge, for the dense kernel */
+#define tbe_dense_column(ws, edge_id) ((ws)->i_block + ((size_t)(edge_id)) * (ws)->stride)
+
+// malloc aligned on WORKSPACE_ALIGN bytes, and madvised for huge pages if asked and large enough
+void* aligned_malloc(size_t size, int huge_pages);
+void aligned_free(void *ptr);
+
+// Number of columns needed by the heavy first traversal of a tree of nb_taxa taxa: floor(log2(nb_taxa))+2
+int tbe_nb_columns(int nb_taxa);
+// Allocates the workspace of one thread, for nb_rows internal ref edges, and the given kernel 
+// (TBE_KERNEL_DENSE: the I matrix, TBE_KERNEL_COLUMNS: the columns, TBE_KERNEL_POPCOUNT: the boot bitsets,
+// TBE_KERNEL_BATCH: the program and a stack of short columns, TBE_KERNEL_FAST: the segment tree,
+// TBE_KERNEL_SPARSE: the columns and the Euler tour, TBE_KERNEL_CONTRACT: the columns and the fingerprints)
+tbe_workspace* new_tbe_workspace(int nb_taxa, int nb_edges_ref, int nb_rows, int kernel, int huge_pages);
+// Column kernel: looks the bootstrap subtrees up in the given cache, shared by the workspaces of all the threads
+void tbe_workspace_add_cache(tbe_workspace *ws, struct column_cache *cache);
+void free_tbe_workspace(tbe_workspace *ws);
+
+#endif